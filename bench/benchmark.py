@@ -0,0 +1,248 @@
+#!/usr/bin/env python
+'''
+Benchmarks the max flow solvers on generated graph families.
+
+Every instance is built through maxflowhelper.Graph.add_edges() and
+solved once by each selected algorithm, timing these phases apart:
+
+    build      add_edges() from prebuilt arrays
+    solve      maxflow()
+    writeback  get_flows()
+    lookup     get_flow() on up to 10000 edges (the edge table)
+    free       dropping the graph
+
+Results go to stdout, one JSON object per line (or CSV with
+--format csv), so that runs can be compared across versions:
+
+    python bench/benchmark.py --scales small,medium > before.jsonl
+
+Run it against a built tree with PYTHONPATH pointing at the build
+directory, e.g. build/lib.linux-x86_64-2.7.
+'''
+
+import array
+import csv
+import json
+import optparse
+import random
+import sys
+import time
+
+from maxflow import maxflowhelper
+
+SOURCE = 0
+SINK = 1
+
+ALGORITHMS = ['edmonds_karp', 'bidirectional_edmonds_karp', 'capacity_scaling',
+              'push_relabel', 'dinic', 'parallel_push_relabel']
+
+PHASES = ['build', 'solve', 'writeback', 'lookup', 'free']
+
+
+class Instance(object):
+    def __init__(self, numvertices):
+        self.numvertices = numvertices
+        self.tails = array.array('i')
+        self.heads = array.array('i')
+        self.caps = array.array('d')
+
+    def add(self, tail, head, cap):
+        self.tails.append(tail)
+        self.heads.append(head)
+        self.caps.append(cap)
+
+
+def grid(size, rng):
+    '''
+    Vision-style segmentation grid: size x size pixels joined to their
+    four neighbours in both directions, with every pixel tied to the
+    source or the sink by its data term.
+    '''
+    inst = Instance(size * size + 2)
+    pixel = lambda x, y: 2 + y * size + x
+    for y in range(size):
+        for x in range(size):
+            v = pixel(x, y)
+            if x + 1 < size:
+                inst.add(v, pixel(x + 1, y), rng.randint(1, 20))
+                inst.add(pixel(x + 1, y), v, rng.randint(1, 20))
+            if y + 1 < size:
+                inst.add(v, pixel(x, y + 1), rng.randint(1, 20))
+                inst.add(pixel(x, y + 1), v, rng.randint(1, 20))
+            data = rng.randint(-100, 100)
+            if data > 0:
+                inst.add(SOURCE, v, data)
+            elif data < 0:
+                inst.add(v, SINK, -data)
+    return inst
+
+
+def layered(size, rng, width=64, degree=4):
+    '''
+    Random level graph in the style of the Washington generator: size
+    layers of width vertices, each joined to degree random vertices of
+    the next layer, with the source feeding the first layer and the
+    last layer draining into the sink.
+    '''
+    inst = Instance(size * width + 2)
+    vertex = lambda layer, i: 2 + layer * width + i
+    for i in range(width):
+        inst.add(SOURCE, vertex(0, i), rng.randint(1, 10000))
+        inst.add(vertex(size - 1, i), SINK, rng.randint(1, 10000))
+    for layer in range(size - 1):
+        for i in range(width):
+            for j in rng.sample(range(width), degree):
+                inst.add(vertex(layer, i), vertex(layer + 1, j), rng.randint(1, 10000))
+    return inst
+
+
+def bipartite(size, rng, degree=5):
+    '''
+    Unit-capacity bipartite matching with size vertices on each side
+    and degree random edges out of every left vertex.
+    '''
+    inst = Instance(2 * size + 2)
+    for i in range(size):
+        inst.add(SOURCE, 2 + i, 1)
+        inst.add(2 + size + i, SINK, 1)
+        for j in rng.sample(range(size), min(degree, size)):
+            inst.add(2 + i, 2 + size + j, 1)
+    return inst
+
+
+def ak(size, rng):
+    '''
+    Hard instance after Cherkassky and Goldberg's AK networks: a long
+    path out of the source whose vertices each leak one unit into a
+    second long path to the sink, so that every unit of flow travels
+    about size arcs and the solvers need on the order of size**2 work.
+    '''
+    inst = Instance(2 * size + 2)
+    p = lambda i: 2 + i
+    q = lambda i: 2 + size + i
+    inst.add(SOURCE, p(0), size)
+    for i in range(size):
+        if i + 1 < size:
+            inst.add(p(i), p(i + 1), size)
+            inst.add(q(i), q(i + 1), size)
+        inst.add(p(i), q(i), 1)
+    inst.add(q(size - 1), SINK, size)
+    return inst
+
+
+def scalefree(size, rng, degree=4):
+    '''
+    Preferential attachment in the style of Barabasi and Albert: every
+    new vertex joins degree earlier ones picked in proportion to their
+    degree, by edges both ways, so that a few early hubs, the source
+    and sink among them, end up with a large share of the arcs.
+    '''
+    inst = Instance(size + 2)
+    ends = [SOURCE, SINK]      # Each vertex once per edge end
+    for v in range(2, size + 2):
+        for u in sorted(set(rng.choice(ends) for i in range(degree))):
+            inst.add(v, u, rng.randint(1, 100))
+            inst.add(u, v, rng.randint(1, 100))
+            ends.extend((u, v))
+    return inst
+
+
+# Generator and size for each family and scale.
+FAMILIES = {
+    'grid': (grid, {'small': 64, 'medium': 256, 'large': 1024}),
+    'layered': (layered, {'small': 32, 'medium': 256, 'large': 2048}),
+    'bipartite': (bipartite, {'small': 1000, 'medium': 20000, 'large': 200000}),
+    'ak': (ak, {'small': 500, 'medium': 2000, 'large': 8000}),
+    'scalefree': (scalefree, {'small': 2000, 'medium': 50000, 'large': 500000}),
+}
+
+
+def run(inst, algorithm, capacity_type, threads):
+    '''
+    Builds and solves inst once and returns the max flow and the time
+    spent in each phase.
+    '''
+    times = {}
+    start = time.time()
+    g = maxflowhelper.Graph(inst.numvertices, len(inst.tails), capacity_type)
+    g.add_edges(inst.tails, inst.heads, inst.caps)
+    times['build'] = time.time() - start
+
+    start = time.time()
+    value = g.maxflow(algorithm, False, threads)
+    times['solve'] = time.time() - start
+
+    start = time.time()
+    g.get_flows()
+    times['writeback'] = time.time() - start
+
+    step = max(1, len(inst.tails) // 10000)
+    start = time.time()
+    for i in range(0, len(inst.tails), step):
+        g.get_flow(inst.tails[i], inst.heads[i])
+    times['lookup'] = time.time() - start
+
+    start = time.time()
+    del g
+    times['free'] = time.time() - start
+    return value, times
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('--families', default=','.join(sorted(FAMILIES)),
+                      help='comma-separated families (default: all)')
+    parser.add_option('--scales', default='small',
+                      help='comma-separated scales: small, medium, large (default: small)')
+    parser.add_option('--algorithms', default=','.join(ALGORITHMS),
+                      help='comma-separated solvers (default: all)')
+    parser.add_option('--capacity-type', default='float64',
+                      help='capacity type of the graphs (default: float64)')
+    parser.add_option('--repeat', type='int', default=1,
+                      help='runs of each solver, all reported (default: 1)')
+    parser.add_option('--threads', type='int', default=0,
+                      help='threads for parallel_push_relabel (default: one per processor)')
+    parser.add_option('--seed', type='int', default=1)
+    parser.add_option('--format', choices=['json', 'csv'], default='json')
+    options, args = parser.parse_args()
+
+    fields = ['family', 'scale', 'vertices', 'edges', 'algorithm', 'capacity_type',
+              'run', 'maxflow', 'agrees'] + PHASES
+    writer = None
+    if options.format == 'csv':
+        writer = csv.DictWriter(sys.stdout, fields)
+        writer.writeheader()
+
+    for family in options.families.split(','):
+        generate, sizes = FAMILIES[family]
+        for scale in options.scales.split(','):
+            inst = generate(sizes[scale], random.Random(options.seed))
+            reference = None
+            for algorithm in options.algorithms.split(','):
+                for attempt in range(options.repeat):
+                    value, times = run(inst, algorithm, options.capacity_type,
+                                       options.threads)
+                    if reference is None:
+                        reference = value
+                    result = {
+                        'family': family,
+                        'scale': scale,
+                        'vertices': inst.numvertices,
+                        'edges': len(inst.tails),
+                        'algorithm': algorithm,
+                        'capacity_type': options.capacity_type,
+                        'run': attempt,
+                        'maxflow': value,
+                        # Every solver must find the same value as the first.
+                        'agrees': abs(value - reference) <= 1e-6 * max(1.0, abs(reference)),
+                    }
+                    result.update(times)
+                    if writer:
+                        writer.writerow(result)
+                    else:
+                        print(json.dumps(result, sort_keys=True))
+                    sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -9,4 +9,4 @@ setup(name='MaxFlow',
       license='MIT',
       packages=['maxflow'],
       package_dir={'maxflow': 'src'},
-      ext_modules=[Extension('maxflow.maxflowhelper', ['src/maxflowhelper/maxflowhelper.c', 'src/maxflowhelper/flowgraph.c', 'src/maxflowhelper/tablefixed.c'])])
+      ext_modules=[Extension('maxflow.maxflowhelper', ['src/maxflowhelper/maxflowhelper.c', 'src/maxflowhelper/flowgraph.c', 'src/maxflowhelper/tablefixed.c', 'src/maxflowhelper/batch.c', 'src/maxflowhelper/graphfile.c', 'src/maxflowhelper/dimacs.c', 'src/maxflowhelper/gomoryhu.c', 'src/maxflowhelper/arcscan.c'], libraries=['pthread'])])
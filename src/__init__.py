@@ -1 +1,2 @@
-from maxflow import FlowGraph, GraphError
+from maxflow import FlowGraph, DenseFlowGraph, GomoryHuTree, GraphError
+from maxflowhelper import CancelToken
@@ -1,3 +1,5 @@
+import array
+import time
 import maxflowhelper
 
 
@@ -9,17 +11,32 @@ class GraphError(Exception):
 class FlowGraph(object):
     SOURCE_ID = 0
     SINK_ID = 1
+    # array.array typecodes for the flows of each capacity type
+    TYPECODES = {'float32': 'f', 'float64': 'd', 'int32': 'i', 'int64': 'l'}
 
-    def __init__(self):
+    def __init__(self, capacity_type='float32', ordering='none'):
         '''
-        Creates an empty flow graph.
+        Creates an empty flow graph.  capacity_type selects the type
+        the capacities are solved in: 'float32' (the default),
+        'float64', 'int32' or 'int64'.  With the integer types the
+        flows are exact and returned as ints.  ordering is 'none',
+        'bfs' or 'rcm'; the last two renumber the vertices inside the
+        solver, breadth-first from "s" or in reverse Cuthill-McKee
+        order, so that neighbours sit close together in memory.
         '''
-        self.edgesbyid = {}      # Maps (tailid, headid) to [tailid, headid, capacity, flow] list
+        if capacity_type not in FlowGraph.TYPECODES:
+            raise GraphError('unknown capacity type "%s"' % capacity_type)
+        self.edgesbyid = {}      # Maps (tailid, headid) to [tailid, headid, capacity, index] list
         self.edgesbyname = {}    # Maps (tailname, headname) to same edge as above
         self.vertexname2id = {}  # Maps vertex names to their ids
+        self.vertexnames = ['s', 't']  # Maps vertex ids back to their names
         self.v2vertices = {}     # Maps vertex names to vertices it points to
         self.vertices2v = {}     # Maps vertex names to vertices that point to it
         self.nextvertexid = 2    # 0 is source "s", 1 is sink "t"
+        # C copy of the graph, kept between solves
+        self.native = maxflowhelper.Graph(capacity_type=capacity_type, ordering=ordering)
+        # Edge flows by index, in insertion order
+        self.flows = array.array(FlowGraph.TYPECODES[capacity_type])
 
     def numvertices(self):
         return self.nextvertexid
@@ -39,6 +56,7 @@ class FlowGraph(object):
         newid = self.nextvertexid
         self.nextvertexid += 1
         self.vertexname2id[vertex] = newid
+        self.vertexnames.append(vertex)
         return newid
 
     def alterflow(self, tail, head, flow, additive=False):
@@ -47,32 +65,42 @@ class FlowGraph(object):
         it adds flow to the existing flow instead of replacing it.
         '''
         try:
+            index = self.edgesbyname[(tail, head)][3]
             if additive:
-                self.edgesbyname[(tail, head)][3] += flow
+                self.flows[index] += flow
             else:
-                self.edgesbyname[(tail, head)][3] = flow
+                self.flows[index] = flow
         except KeyError:
             raise GraphError('there is no edge from %s to %s' % (tail, head))
 
-    def addedge(self, tail, head, cap, increaseifexists=False):
+    def addedge(self, tail, head, cap, increaseifexists=False, cost=None):
         '''
-        Adds an edge from vertex tail to vertex head with
-        floating-point capacity cap.  Vertices can be named using any
-        hashable Python object.  If increaseifexists is True and the
-        edge already exists, its capacity is increased by the given
-        capacity instead of replaced.
+        Adds an edge from vertex tail to vertex head with capacity
+        cap, which is truncated for the integer capacity types and
+        raises OverflowError outside the range of the capacity type.
+        Vertices can be named using any hashable Python object.  If
+        increaseifexists is True and the edge already exists, its
+        capacity is increased by the given capacity instead of
+        replaced.  cost is the cost per unit of flow for the 'min_cost'
+        algorithm; edges cost nothing unless given one, and an existing
+        edge keeps its cost if cost is None.
         '''
         if (tail, head) in self.edgesbyname:
+            edge = self.edgesbyname[(tail, head)]
             if increaseifexists:
-                self.edgesbyname[(tail, head)][2] += cap
-            else:
-                self.edgesbyname[(tail, head)][2] = cap
+                cap += edge[2]
+            self.native.set_capacity(edge[0], edge[1], cap)
+            edge[2] = cap
+            if cost is not None:
+                self.native.set_edge_cost(edge[3], cost)
         else:
             tailid = self._getvertexid(tail)
             headid = self._getvertexid(head)
-            edge = [tailid, headid, cap, 0.0]
+            edge = [tailid, headid, cap, len(self.flows)]
+            self.native.add_edge(tailid, headid, cap, cost or 0)
             self.edgesbyid[(tailid, headid)] = edge
             self.edgesbyname[(tail, head)] = edge
+            self.flows.append(0)
             if tail in self.v2vertices:
                 self.v2vertices[tail].append(head)
             else:
@@ -82,17 +110,130 @@ class FlowGraph(object):
             else:
                 self.vertices2v[head] = [tail]
 
-    def calculatemaxflow(self):
+    def calculatemaxflow(self, algorithm='edmonds_karp', warmstart=False, threads=0,
+                         stats=False, deadline=0, max_iterations=0, cancel=None,
+                         reduce=False, sources=None, sinks=None):
         '''
         Calculates the max flow from vertex "s" to vertex "t" and
         returns the resulting scalar.  After running this method, call
         calculatemaxflow() to retrieve the flows on individual edges.
         The bulk of this method is implemented in C for efficiency.
+        algorithm selects the solver.  'edmonds_karp' augments along
+        BFS paths.  'push_relabel' is highest-label push-relabel,
+        usually much faster on large or dense graphs, and 'dinic'
+        sends blocking flows on level graphs, which suits
+        unit-capacity matching.  'parallel_push_relabel' runs
+        push-relabel for a single large graph on as many native
+        threads as threads says, one per processor by default.
+        'min_cost' finds the max flow of least total cost by
+        successive cheapest augmenting paths; see flowcost().
+        If warmstart is True, the solve continues from the flows of
+        the previous one, adjusted for any capacity changes since,
+        instead of starting from zero; this is much cheaper when only
+        a few capacities changed.
+        If stats is True, a (maxflow, stats) pair is returned instead,
+        where stats is the dict of solver counters and timings from
+        maxflowhelper.Graph.stats() plus writeback_seconds, the time
+        taken to copy the flows back to the edges.
+        deadline (in seconds), max_iterations (augmenting path
+        searches, or vertex discharges for push-relabel) and cancel, a
+        maxflowhelper.CancelToken whose cancel() may be called from
+        another thread, bound the solve.  One that reaches a bound
+        returns the flow found so far, which is feasible but may not
+        be maximum; isoptimal() says which.
+        If reduce is True, the solve first prunes the edges no flow
+        from "s" to "t" can use, merges parallel edges and contracts
+        chains of vertices with one edge in and one out, then maps the
+        flows of the smaller graph back onto the edges.  It always
+        starts from zero flow.
+        sources and sinks are lists of vertex names to solve between
+        instead of "s" and "t": the flow is the largest that can leave
+        the sources together and reach the sinks together.  mincut()
+        then returns the side of the sources.
         '''
-        if 's' not in self.vertexname2id or 't' not in self.vertexname2id:
+        if sources or sinks:
+            sourceids = self._terminalids(sources or ['s'])
+            sinkids = self._terminalids(sinks or ['t'])
+        elif 's' not in self.vertexname2id or 't' not in self.vertexname2id:
             raise GraphError('graph must have a source named "s" and a sink named "t"')
+        else:
+            sourceids = sinkids = None
         # Call C helper for speed.
-        return maxflowhelper.maxflow(self.edgesbyid.values(), self.nextvertexid)
+        maxflowval = self.native.maxflow(algorithm, warmstart, threads,
+                                         deadline, max_iterations, cancel, reduce,
+                                         sourceids, sinkids)
+        start = time.time()
+        self.native.get_flows(self.flows)
+        if stats:
+            solvestats = self.native.stats()
+            solvestats['writeback_seconds'] = time.time() - start
+            return maxflowval, solvestats
+        return maxflowval
+
+    def flowcost(self):
+        '''
+        Returns the total cost of the flows, the sum over the edges of
+        flow times cost.
+        '''
+        return self.native.flow_cost()
+
+    def getcost(self, tail, head):
+        '''
+        Returns the cost per unit of flow from vertex tail to vertex
+        head, or 0.0 if there is no edge from tail to head.
+        '''
+        if tail not in self.vertexname2id:
+            raise GraphError('unknown vertex "%s"' % tail)
+        if head not in self.vertexname2id:
+            raise GraphError('unknown vertex "%s"' % head)
+        try:
+            return self.native.get_edge_cost(self.edgesbyname[(tail, head)][3])
+        except KeyError:
+            return 0.0
+
+    def _terminalids(self, names):
+        try:
+            return [self.vertexname2id[name] for name in names]
+        except KeyError as e:
+            raise GraphError('unknown vertex "%s"' % (e.args[0],))
+
+    def isoptimal(self):
+        '''
+        Returns False if a deadline, iteration cap or cancellation
+        stopped the last calculatemaxflow() before the flow was
+        maximum.
+        '''
+        return self.native.optimal()
+
+    def mincut(self):
+        '''
+        Returns the set of vertices on the source side of a minimum
+        cut: the vertices still reachable from "s" through edges with
+        spare capacity or backward along edges with flow.  The edges
+        from this set to the rest of the graph are saturated, and
+        their capacities add up to the max flow.  Call it after
+        calculatemaxflow().
+        '''
+        return set(self.vertexnames[v] for v in self.native.min_cut())
+
+    def gomoryhutree(self, algorithm='edmonds_karp', threads=1):
+        '''
+        Returns a GomoryHuTree giving the minimum cut between every
+        pair of vertices, with the edges taken as undirected.  It
+        solves one max flow per vertex in C with the given algorithm,
+        on a copy of the graph that leaves the flows alone.  With
+        threads other than 1 (0 for one per processor), that many
+        copies solve cuts at once.
+        '''
+        return GomoryHuTree(self, self.native.gomory_hu_tree(algorithm, threads))
+
+    def save(self, path):
+        '''
+        Writes the graph to a binary file that DenseFlowGraph.load()
+        maps straight into a native graph.  Vertices are stored by
+        their ids, with "s" as 0 and "t" as 1, so the names are lost.
+        '''
+        self.native.save(path)
 
     def getflow(self, tail, head):
         '''
@@ -104,7 +245,7 @@ class FlowGraph(object):
         if head not in self.vertexname2id:
             raise GraphError('unknown vertex "%s"' % head)
         try:
-            return self.edgesbyname[(tail, head)][3]
+            return self.flows[self.edgesbyname[(tail, head)][3]]
         except KeyError:
             return 0.0
 
@@ -134,3 +275,193 @@ class FlowGraph(object):
             return self.vertices2v[head]
         except KeyError:
             return []
+
+
+class DenseFlowGraph(object):
+    def __init__(self, source, sink, capacity_type='float32', numvertices=0, numedges=0,
+                 ordering='none', compact=False):
+        '''
+        Creates an empty flow graph over the integer vertex ids
+        0..n-1, with the max flow going from vertex source to vertex
+        sink.  Edges are kept only in the native graph, with none of
+        the name maps and adjacency lists of FlowGraph.  capacity_type
+        and ordering are as for FlowGraph; numvertices and numedges
+        are optional size hints.  With compact=True a solved graph
+        keeps its edges in its residual arcs alone, as for
+        maxflowhelper.Graph.set_compact().
+        '''
+        if capacity_type not in FlowGraph.TYPECODES:
+            raise GraphError('unknown capacity type "%s"' % capacity_type)
+        if source < 0 or sink < 0 or source == sink:
+            raise GraphError('source and sink must be distinct non-negative vertex ids')
+        self.source = source
+        self.sink = sink
+        self.native = maxflowhelper.Graph(numvertices, numedges, capacity_type,
+                                          source, sink, ordering, compact)
+
+    @classmethod
+    def load(cls, path, ordering='none', compact=False):
+        '''
+        Returns the graph in a binary file written by save() or
+        FlowGraph.save().  The file is memory-mapped and handed to the
+        native graph whole, with no per-edge work in Python.
+        '''
+        return cls._fromnative(maxflowhelper.load_graph(path), ordering, compact)
+
+    @classmethod
+    def readdimacs(cls, path, capacity_type='float32', ordering='none', compact=False):
+        '''
+        Returns the max flow problem in a DIMACS file, read in C.
+        Vertices keep their ids from the file, and the source and
+        sink are the ones its "n" lines name.
+        '''
+        return cls._fromnative(maxflowhelper.read_dimacs(path, capacity_type), ordering,
+                               compact)
+
+    @classmethod
+    def _fromnative(cls, native, ordering='none', compact=False):
+        graph = cls.__new__(cls)
+        native.set_ordering(ordering)
+        native.set_compact(compact)
+        graph.native = native
+        graph.source, graph.sink = native.terminals()
+        return graph
+
+    def save(self, path):
+        '''
+        Writes the graph to a binary file for load(), edge costs
+        included.  The edges are grouped by tail, which renumbers them
+        unless they were added in that order.
+        '''
+        self.native.save(path)
+
+    def numvertices(self):
+        return self.native.num_vertices()
+
+    def numedges(self):
+        return self.native.num_edges()
+
+    def addedge(self, tail, head, cap, cost=0):
+        '''
+        Adds an edge from vertex id tail to vertex id head with
+        capacity cap and cost per unit of flow cost.  Edges are never
+        merged: parallel edges, edges in both directions and self
+        edges are all kept as given.
+        '''
+        self.native.add_edge(tail, head, cap, cost)
+
+    def addedges(self, tails, heads, caps, costs=None):
+        '''
+        Adds many edges at once from arrays of tail ids, head ids,
+        capacities and optionally costs, as for
+        maxflowhelper.Graph.add_edges().
+        '''
+        self.native.add_edges(tails, heads, caps, costs)
+
+    def setedgecost(self, index, cost):
+        '''
+        Changes the cost of the edge with the given index, in the
+        order the edges were added.
+        '''
+        try:
+            self.native.set_edge_cost(index, cost)
+        except IndexError:
+            raise GraphError('there is no edge %d' % index)
+
+    def flowcost(self):
+        '''
+        Returns the total cost of the flows.
+        '''
+        return self.native.flow_cost()
+
+    def setcapacity(self, tail, head, cap):
+        '''
+        Changes the capacity of the existing edge from tail to head,
+        the first one added if there are parallel edges.
+        '''
+        try:
+            self.native.set_capacity(tail, head, cap)
+        except KeyError:
+            raise GraphError('there is no edge from %s to %s' % (tail, head))
+
+    def setedgecapacity(self, index, cap):
+        '''
+        Changes the capacity of the edge with the given index, in the
+        order the edges were added.
+        '''
+        try:
+            self.native.set_edge_capacity(index, cap)
+        except IndexError:
+            raise GraphError('there is no edge %d' % index)
+
+    def calculatemaxflow(self, algorithm='edmonds_karp', warmstart=False, threads=0,
+                         stats=False, deadline=0, max_iterations=0, cancel=None,
+                         reduce=False, sources=None, sinks=None):
+        '''
+        Calculates the max flow from source to sink and returns the
+        resulting scalar; the arguments are as for
+        FlowGraph.calculatemaxflow(), with sources and sinks given as
+        lists of vertex ids.  The flows stay in the native graph, so
+        stats carries no writeback_seconds.
+        '''
+        maxflowval = self.native.maxflow(algorithm, warmstart, threads,
+                                         deadline, max_iterations, cancel, reduce,
+                                         sources, sinks)
+        if stats:
+            return maxflowval, self.native.stats()
+        return maxflowval
+
+    def getflow(self, tail, head):
+        '''
+        Returns the flow from vertex tail to vertex head, summed over
+        parallel edges, or 0 if there is no edge from tail to head.
+        '''
+        return self.native.get_flow(tail, head)
+
+    def getflows(self, out=None):
+        '''
+        Returns the flows on all edges in the order they were added,
+        as an array.array of the capacity type, or writes them into
+        the array out.
+        '''
+        return self.native.get_flows(out)
+
+    def isoptimal(self):
+        '''
+        Returns False if a bound stopped the last calculatemaxflow()
+        before the flow was maximum.
+        '''
+        return self.native.optimal()
+
+    def mincut(self):
+        '''
+        Returns the ids of the vertices on the source side of a
+        minimum cut, in increasing order, as an array.array('i').
+        Call it after calculatemaxflow().
+        '''
+        return self.native.min_cut()
+
+    def gomoryhutree(self, algorithm='edmonds_karp', threads=1):
+        '''
+        Returns the maxflowhelper.CutTree of the graph, as for
+        FlowGraph.gomoryhutree(); its min_cut(u, v) takes vertex ids.
+        '''
+        return self.native.gomory_hu_tree(algorithm, threads)
+
+
+class GomoryHuTree(object):
+    def __init__(self, graph, tree):
+        self.vertexname2id = dict(graph.vertexname2id)
+        self.tree = tree         # The maxflowhelper.CutTree
+
+    def mincut(self, u, v):
+        '''
+        Returns the capacity of a minimum cut between vertices u and
+        v of the graph the tree was built from.
+        '''
+        try:
+            return self.tree.min_cut(self.vertexname2id[u], self.vertexname2id[v])
+        except KeyError as e:
+            raise GraphError('unknown vertex "%s"' % (e.args[0],))
+        except ValueError:
+            raise GraphError('there is no cut between a vertex and itself')
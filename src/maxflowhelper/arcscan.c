@@ -0,0 +1,215 @@
+#include <stddef.h>
+#include "arcscan.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/* The plain versions, which compilers are free to vectorize. */
+#define PLAIN_SCAN(name, type)                                              \
+    static uint64_t name(const type *residual, const int *index, int count, \
+                         type min)                                          \
+    {                                                                       \
+        uint64_t mask = 0;                                                  \
+        type x;                                                             \
+        int k;                                                              \
+        for(k = 0; k < count; k++) {                                        \
+            x = index ? residual[index[k]] : residual[k];                   \
+            mask |= (uint64_t) (x > 0 && x >= min) << k;                    \
+        }                                                                   \
+        return mask;                                                        \
+    }
+
+PLAIN_SCAN(scanPlainFloat, float)
+PLAIN_SCAN(scanPlainDouble, double)
+PLAIN_SCAN(scanPlainInt32, int32_t)
+PLAIN_SCAN(scanPlainInt64, int64_t)
+
+static const struct ArcScan plainScan = {
+    scanPlainFloat, scanPlainDouble, scanPlainInt32, scanPlainInt64
+};
+
+#ifdef SCAN_X86
+/* AVX2 works on 8 arcs at a time, or 4 with 64-bit capacities.  The
+   lanes past count are masked out of the loads and gathers and come
+   out as zero, which is never positive. */
+
+__attribute__((target("avx2")))
+static inline __m256i lanes8(int left)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(left), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+__attribute__((target("avx2")))
+static inline __m128i lanes4(int left)
+{
+    return _mm_cmpgt_epi32(_mm_set1_epi32(left), _mm_setr_epi32(0, 1, 2, 3));
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanAVX2Float(const float *residual, const int *index, int count, float min)
+{
+    __m256 zero = _mm256_setzero_ps(), low = _mm256_set1_ps(min), x;
+    __m256i lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 8) {
+        lanes = lanes8(count - k);
+        x = index ? _mm256_mask_i32gather_ps(zero, residual, _mm256_maskload_epi32(index + k, lanes),
+                                             _mm256_castsi256_ps(lanes), 4) :
+                    _mm256_maskload_ps(residual + k, lanes);
+        x = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GT_OQ), _mm256_cmp_ps(x, low, _CMP_GE_OQ));
+        mask |= (uint64_t) _mm256_movemask_ps(x) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanAVX2Double(const double *residual, const int *index, int count, double min)
+{
+    __m256d zero = _mm256_setzero_pd(), low = _mm256_set1_pd(min), x;
+    __m256i lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 4) {
+        lanes = _mm256_cvtepi32_epi64(lanes4(count - k));
+        x = index ? _mm256_mask_i32gather_pd(zero, residual,
+                                             _mm_maskload_epi32(index + k, lanes4(count - k)),
+                                             _mm256_castsi256_pd(lanes), 8) :
+                    _mm256_maskload_pd(residual + k, lanes);
+        x = _mm256_and_pd(_mm256_cmp_pd(x, zero, _CMP_GT_OQ), _mm256_cmp_pd(x, low, _CMP_GE_OQ));
+        mask |= (uint64_t) _mm256_movemask_pd(x) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanAVX2Int32(const int32_t *residual, const int *index, int count, int32_t min)
+{
+    __m256i zero = _mm256_setzero_si256(), low = _mm256_set1_epi32(min), lanes, x;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 8) {
+        lanes = lanes8(count - k);
+        x = index ? _mm256_mask_i32gather_epi32(zero, (const int *) residual,
+                                                _mm256_maskload_epi32(index + k, lanes), lanes, 4) :
+                    _mm256_maskload_epi32((const int *) residual + k, lanes);
+        x = _mm256_andnot_si256(_mm256_cmpgt_epi32(low, x), _mm256_cmpgt_epi32(x, zero));
+        mask |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(x)) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanAVX2Int64(const int64_t *residual, const int *index, int count, int64_t min)
+{
+    __m256i zero = _mm256_setzero_si256(), low = _mm256_set1_epi64x(min), lanes, x;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 4) {
+        lanes = _mm256_cvtepi32_epi64(lanes4(count - k));
+        x = index ? _mm256_mask_i32gather_epi64(zero, (const long long *) residual,
+                                                _mm_maskload_epi32(index + k, lanes4(count - k)),
+                                                lanes, 8) :
+                    _mm256_maskload_epi64((const long long *) residual + k, lanes);
+        x = _mm256_andnot_si256(_mm256_cmpgt_epi64(low, x), _mm256_cmpgt_epi64(x, zero));
+        mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(x)) << k;
+    }
+    return mask;
+}
+
+static const struct ArcScan avx2Scan = {
+    scanAVX2Float, scanAVX2Double, scanAVX2Int32, scanAVX2Int64
+};
+
+/* AVX-512 works on 16 arcs at a time, or 8 with 64-bit capacities,
+   and masks the lanes past count with its mask registers. */
+
+__attribute__((target("avx512f")))
+static uint64_t scanAVX512Float(const float *residual, const int *index, int count, float min)
+{
+    __m512 zero = _mm512_setzero_ps(), low = _mm512_set1_ps(min), x;
+    __mmask16 lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 16) {
+        lanes = count - k >= 16 ? 0xFFFF : (__mmask16) ((1u << (count - k)) - 1);
+        x = index ? _mm512_mask_i32gather_ps(zero, lanes, _mm512_maskz_loadu_epi32(lanes, index + k),
+                                             residual, 4) :
+                    _mm512_maskz_loadu_ps(lanes, residual + k);
+        mask |= (uint64_t) _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(x, zero, _CMP_GT_OQ),
+                                                   x, low, _CMP_GE_OQ) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t scanAVX512Double(const double *residual, const int *index, int count, double min)
+{
+    __m512d zero = _mm512_setzero_pd(), low = _mm512_set1_pd(min), x;
+    __mmask8 lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 8) {
+        lanes = count - k >= 8 ? 0xFF : (__mmask8) ((1u << (count - k)) - 1);
+        x = index ? _mm512_mask_i32gather_pd(zero, lanes,
+                                             _mm512_castsi512_si256(_mm512_maskz_loadu_epi32(lanes, index + k)),
+                                             residual, 8) :
+                    _mm512_maskz_loadu_pd(lanes, residual + k);
+        mask |= (uint64_t) _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(x, zero, _CMP_GT_OQ),
+                                                   x, low, _CMP_GE_OQ) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t scanAVX512Int32(const int32_t *residual, const int *index, int count, int32_t min)
+{
+    __m512i zero = _mm512_setzero_si512(), low = _mm512_set1_epi32(min), x;
+    __mmask16 lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 16) {
+        lanes = count - k >= 16 ? 0xFFFF : (__mmask16) ((1u << (count - k)) - 1);
+        x = index ? _mm512_mask_i32gather_epi32(zero, lanes, _mm512_maskz_loadu_epi32(lanes, index + k),
+                                                residual, 4) :
+                    _mm512_maskz_loadu_epi32(lanes, residual + k);
+        mask |= (uint64_t) _mm512_mask_cmpge_epi32_mask(_mm512_cmpgt_epi32_mask(x, zero), x, low) << k;
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t scanAVX512Int64(const int64_t *residual, const int *index, int count, int64_t min)
+{
+    __m512i zero = _mm512_setzero_si512(), low = _mm512_set1_epi64(min), x;
+    __mmask8 lanes;
+    uint64_t mask = 0;
+    int k;
+    for(k = 0; k < count; k += 8) {
+        lanes = count - k >= 8 ? 0xFF : (__mmask8) ((1u << (count - k)) - 1);
+        x = index ? _mm512_mask_i32gather_epi64(zero, lanes,
+                                                _mm512_castsi512_si256(_mm512_maskz_loadu_epi32(lanes, index + k)),
+                                                residual, 8) :
+                    _mm512_maskz_loadu_epi64(lanes, residual + k);
+        mask |= (uint64_t) _mm512_mask_cmpge_epi64_mask(_mm512_cmpgt_epi64_mask(x, zero), x, low) << k;
+    }
+    return mask;
+}
+
+static const struct ArcScan avx512Scan = {
+    scanAVX512Float, scanAVX512Double, scanAVX512Int32, scanAVX512Int64
+};
+#endif /* SCAN_X86 */
+
+const struct ArcScan *ArcScan_select(void)
+{
+#ifdef SCAN_X86
+    if(__builtin_cpu_supports("avx512f"))
+        return &avx512Scan;
+    if(__builtin_cpu_supports("avx2"))
+        return &avx2Scan;
+#endif
+    return &plainScan;
+}
@@ -0,0 +1,22 @@
+#ifndef ARCSCAN_INCLUDED
+#define ARCSCAN_INCLUDED
+
+#include <stdint.h>
+
+/* Tests for residual capacity many arcs at a time, for the searches
+   over vertices of high degree.  Each returns a mask with bit k set if
+   residual[index[k]], or residual[k] if index is NULL, is positive and
+   at least min, for every k < count; count is at most 64.  There is one
+   for each capacity type, named after its solvers' suffix. */
+struct ArcScan {
+    uint64_t (*scan_float)(const float *residual, const int *index, int count, float min);
+    uint64_t (*scan_double)(const double *residual, const int *index, int count, double min);
+    uint64_t (*scan_int32)(const int32_t *residual, const int *index, int count, int32_t min);
+    uint64_t (*scan_int64)(const int64_t *residual, const int *index, int count, int64_t min);
+};
+
+/* Returns the widest versions this processor runs: AVX-512 or AVX2,
+   with gathers for index, on x86-64, and plain C elsewhere. */
+const struct ArcScan *ArcScan_select(void);
+
+#endif /* ARCSCAN_INCLUDED */
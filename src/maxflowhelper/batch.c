@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "batch.h"
+
+struct BatchInfo {
+    struct BatchJob *jobs;
+    int numJobs;
+    int next;              /* Next job to hand out */
+    pthread_mutex_t lock;
+    double (*solve)(FlowGraph g);
+};
+
+static void runJob(struct BatchJob *job, double (*solve)(FlowGraph g))
+{
+    FlowGraph g = job->graph;
+    if(!g) {
+        g = Graph_new(0, job->count);
+        Graph_addEdges(g, job->from, job->to, job->capacity, job->count);
+    } else if(!job->warmstart) {
+        Graph_resetFlows(g);
+    }
+    job->maxflow = solve(g);
+    if(!job->graph) {
+        Graph_getFlows(g, job->flows, CAP_DOUBLE);
+        Graph_free(g);
+    }
+}
+
+/* Worker loop: jobs are handed out one at a time, so that a few large
+   instances do not hold up the small ones queued behind them. */
+static void *worker(void *arg)
+{
+    struct BatchInfo *bi = (struct BatchInfo *) arg;
+    int i;
+    for(;;) {
+        pthread_mutex_lock(&bi->lock);
+        i = bi->next++;
+        pthread_mutex_unlock(&bi->lock);
+        if(i >= bi->numJobs)
+            return NULL;
+        runJob(bi->jobs + i, bi->solve);
+    }
+}
+
+void Batch_run(struct BatchJob *jobs, int numJobs, double (*solve)(FlowGraph g),
+               int threads)
+{
+    struct BatchInfo bi;
+    pthread_t *tids;
+    int i, started;
+
+    if(threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > numJobs)
+        threads = numJobs;
+    bi.jobs = jobs;
+    bi.numJobs = numJobs;
+    bi.next = 0;
+    bi.solve = solve;
+    pthread_mutex_init(&bi.lock, NULL);
+
+    /* The calling thread works too, and picks up everything if no
+       threads could be started. */
+    tids = (pthread_t *) malloc((threads > 1 ? threads - 1 : 1) * sizeof(pthread_t));
+    started = 0;
+    for(i = 1; tids && i < threads; i++)
+        if(pthread_create(&tids[started], NULL, worker, &bi) == 0)
+            started++;
+    worker(&bi);
+    for(i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+    pthread_mutex_destroy(&bi.lock);
+}
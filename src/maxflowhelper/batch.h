@@ -0,0 +1,28 @@
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include "flowgraph.h"
+
+/* One independent max flow instance.  If graph is NULL, the job builds
+   its own graph from the count edges in from/to/capacity, writes the
+   edge flows into flows and frees the graph again; otherwise it solves
+   graph in place, continuing from its current flow if warmstart is
+   set. */
+struct BatchJob {
+    FlowGraph graph;
+    int warmstart;
+    const int *from;
+    const int *to;
+    const double *capacity;
+    int count;
+    double *flows;
+    double maxflow;        /* Result */
+};
+
+/* Runs all jobs with solve on up to threads native threads (one per
+   processor if threads <= 0).  Must be called without holding any
+   interpreter lock, since it blocks until every job is done. */
+void Batch_run(struct BatchJob *jobs, int numJobs, double (*solve)(FlowGraph g),
+               int threads);
+
+#endif /* BATCH_INCLUDED */
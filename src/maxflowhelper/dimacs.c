@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "dimacs.h"
+
+/* The file is read in chunks of this size; a line must fit in one. */
+#define DIMACS_CHUNK (1 << 20)
+
+struct Reader {
+    FlowGraph graph;
+    CapacityType type;
+    long numVertices;          /* -1 until the problem line */
+    long numArcs;
+    long arcs;                 /* Arc lines so far */
+    long source;               /* 0 until named */
+    long sink;
+    int terminalsSet;
+};
+
+static inline const char *skipSpace(const char *p)
+{
+    while(*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+    return p;
+}
+
+/* Parses an unsigned decimal number into *x and returns the rest of
+   the line, or NULL if there is none.  Much cheaper than strtol(). */
+static inline const char *parseNumber(const char *p, long *x)
+{
+    const char *start;
+    p = skipSpace(p);
+    start = p;
+    for(*x = 0; *p >= '0' && *p <= '9' && p - start < 18; p++)
+        *x = 10 * *x + (*p - '0');
+    return p > start ? p : NULL;
+}
+
+/* Parses a vertex id into *v and returns the rest of the line, or NULL
+   if there is none or it is out of range. */
+static const char *parseVertex(struct Reader *rd, const char *p, long *v)
+{
+    if(!(p = parseNumber(p, v)) || *v < 1 || *v > rd->numVertices)
+        return NULL;
+    return p;
+}
+
+/* Handles one line, without its newline; returns NULL or what is
+   wrong with it. */
+static const char *parseLine(struct Reader *rd, const char *p)
+{
+    long tail, head, whole;
+    int hint;
+    double capacity;
+    const char *rest;
+    char *end;
+
+    p = skipSpace(p);
+    switch(*p) {
+    case 'a':
+        if(rd->numVertices < 0)
+            return "arc before the problem line";
+        if(!rd->terminalsSet) {
+            if(!rd->source || !rd->sink)
+                return "arc before the source and sink are named";
+            Graph_setTerminals(rd->graph, (int) rd->source, (int) rd->sink);
+            rd->terminalsSet = 1;
+        }
+        if(!(p = parseVertex(rd, p + 1, &tail)) || !(p = parseVertex(rd, p, &head)))
+            return "bad vertex id";
+        /* Integer capacities are the common case; anything else goes
+           through strtod(). */
+        if((rest = parseNumber(p, &whole)) && (*rest == '\0' || *rest == ' ' ||
+                                              *rest == '\t' || *rest == '\r')) {
+            capacity = whole;
+        } else {
+            capacity = strtod(p, &end);
+            if(end == p || capacity < 0)
+                return "bad capacity";
+            rest = end;
+        }
+        if(*skipSpace(rest))
+            return "trailing characters";
+        if(++rd->arcs > rd->numArcs)
+            return "more arcs than the problem line says";
+        if(!Graph_capacityFits(rd->graph, capacity))
+            return "capacity out of range for the capacity type";
+        if(!Graph_addEdge(rd->graph, (int) tail, (int) head, capacity))
+            return "out of memory";
+        return NULL;
+    case 'n':
+        if(rd->numVertices < 0)
+            return "node line before the problem line";
+        if(rd->terminalsSet)
+            return "node line after the arcs";
+        if(!(p = parseVertex(rd, p + 1, &tail)))
+            return "bad vertex id";
+        p = skipSpace(p);
+        if((*p != 's' && *p != 't') || *skipSpace(p + 1))
+            return "node line must name the source 's' or the sink 't'";
+        if(*p == 's')
+            rd->source = tail;
+        else
+            rd->sink = tail;
+        if(rd->source && rd->source == rd->sink)
+            return "source and sink are the same vertex";
+        return NULL;
+    case 'p':
+        if(rd->numVertices >= 0)
+            return "second problem line";
+        p = skipSpace(p + 1);
+        if(strncmp(p, "max", 3) != 0 || skipSpace(p + 3) == p + 3)
+            return "not a max flow problem";
+        rd->numVertices = strtol(p + 3, &end, 10);
+        p = end;
+        rd->numArcs = strtol(p, &end, 10);
+        if(end == p || rd->numVertices < 2 || rd->numVertices >= INT_MAX ||
+           rd->numArcs < 0 || rd->numArcs > INT_MAX || *skipSpace(end))
+            return "bad problem line";
+        if(rd->numArcs > GRAPH_MAX_EDGES)
+            return "too many arcs";
+        /* A file can claim more arcs than it has; the edge arrays grow
+           past the hint as the arcs come. */
+        hint = rd->numArcs < GRAPH_MAX_HINT ? (int) rd->numArcs : GRAPH_MAX_HINT;
+        rd->graph = Graph_newTyped((int) rd->numVertices + 1, hint, rd->type);
+        if(!rd->graph)
+            return "out of memory";
+        return NULL;
+    case 'c':
+    case '\0':
+        return NULL;
+    default:
+        return "unknown line type";
+    }
+}
+
+FlowGraph Dimacs_read(const char *path, CapacityType type, const char **error,
+                      long *line)
+{
+    struct Reader rd;
+    FILE *f;
+    char *buffer, *p, *newline;
+    size_t kept = 0, got;
+    int eof = 0, saved;
+
+    *error = NULL;
+    *line = 0;
+    if(!(f = fopen(path, "rb")))
+        return NULL;
+    if(!(buffer = (char *) malloc(DIMACS_CHUNK + 1))) {
+        fclose(f);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(&rd, 0, sizeof(rd));
+    rd.type = type;
+    rd.numVertices = -1;
+
+    /* Read a chunk at a time and parse the complete lines in it; the
+       partial line at the end moves to the front for the next chunk. */
+    while(!*error && !eof) {
+        got = fread(buffer + kept, 1, DIMACS_CHUNK - kept, f);
+        if(got < DIMACS_CHUNK - kept) {
+            if(ferror(f))
+                break;
+            eof = 1;
+        }
+        kept += got;
+        buffer[kept] = '\0';
+        for(p = buffer; !*error; p = newline + 1) {
+            if(!(newline = (char *) memchr(p, '\n', buffer + kept - p))) {
+                if(!eof && p == buffer && kept == DIMACS_CHUNK)
+                    *error = "line too long";
+                else if(eof && p < buffer + kept) {
+                    ++*line;
+                    *error = parseLine(&rd, p);
+                }
+                break;
+            }
+            *newline = '\0';
+            ++*line;
+            /* Comments are most of some files; skip them without
+               looking further. */
+            if(*p != 'c')
+                *error = parseLine(&rd, p);
+        }
+        if(!*error && !eof) {
+            kept = buffer + kept - p;
+            memmove(buffer, p, kept);
+        }
+    }
+    saved = errno;
+    if(!*error && ferror(f)) {
+        if(rd.graph)
+            Graph_free(rd.graph);
+        free(buffer);
+        fclose(f);
+        errno = saved;
+        return NULL;
+    }
+    free(buffer);
+    fclose(f);
+
+    if(!*error) {
+        /* What is missing belongs to no particular line. */
+        *line = 0;
+        if(rd.numVertices < 0)
+            *error = "no problem line";
+        else if(!rd.source || !rd.sink)
+            *error = "source or sink not named";
+        else if(rd.arcs != rd.numArcs)
+            *error = "fewer arcs than the problem line says";
+        else if(!rd.terminalsSet)
+            Graph_setTerminals(rd.graph, (int) rd.source, (int) rd.sink);
+    }
+    if(*error) {
+        if(rd.graph)
+            Graph_free(rd.graph);
+        return NULL;
+    }
+    return rd.graph;
+}
@@ -0,0 +1,17 @@
+#ifndef DIMACS_INCLUDED
+#define DIMACS_INCLUDED
+
+#include "flowgraph.h"
+
+/* Reads a max flow problem in DIMACS format: a "p max <nodes> <arcs>"
+   line, "n <id> s" and "n <id> t" lines naming the source and sink,
+   and an "a <tail> <head> <cap>" line for every arc, with "c" lines
+   as comments.  Vertices keep their ids from the file (1..nodes),
+   with the terminals set on the graph, and arcs become edges in file
+   order.  Returns NULL on failure, with *error describing a malformed
+   file and *line the line at fault (0 for the file as a whole), or
+   with *error NULL and errno set if the file could not be read. */
+FlowGraph Dimacs_read(const char *path, CapacityType type, const char **error,
+                      long *line);
+
+#endif /* DIMACS_INCLUDED */
@@ -1,291 +1,1802 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <float.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 #include "flowgraph.h"
 #include "tablefixed.h"
+#include "arcscan.h"
 
-#define DEGREE_ALLOC 10
-#define INFINITY     1000000.0
+#define EDGE_ALLOC 10
 #define SOURCE_ID 0
 #define SINK_ID   1
 
-/* This MIN is not safe if X or Y have side effects, so be careful! */
+/* These are not safe if X or Y have side effects, so be careful! */
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 
 
-struct Edge {
-    float capacity;
-    float flow;
-    struct Vertex *from;
-    struct Vertex *to;
-    /* This is used only for computing maxflow; it's not part of the actual graph. */
-    struct Edge *reverseEdge;
+/* The bounds on a solve from Graph_setLimits(). */
+struct Limits {
+    double seconds;
+    long iterations;
+    const volatile int *cancel;
+    double deadline;        /* When the running solve must stop */
+    int active;             /* Only solves are bounded, not flow repairs */
+    int stopped;            /* A bound stopped the running solve; cleared
+                               when it returns */
 };
 
-struct Vertex {
-    int id;
-    int degree;
-    int slots;
-    struct Edge **edges;  /* Array of pointers to Edges */
-    /* This is used only for computing maxflow; it's not part of the actual graph. */
-    struct Edge *predEdge;
+/* A set of vertices that can be emptied in constant time: bit v % 64 of
+   word v / 64 only counts while the word's stamp matches the epoch. */
+struct VertexSet {
+    uint64_t *bits;
+    unsigned *stamp;
+    unsigned epoch;
+    int words;
 };
 
-struct Graph {
-    TableFixed_T edges;     /* Maps (to, from) to Edge  */
-    TableFixed_T vertices;  /* Maps vertex id to Vertex */
-    struct Vertex *source;
-    struct Vertex *sink;
+static void setInit(struct VertexSet *s, int n)
+{
+    s->words = (n + 63) / 64;
+    s->bits = (uint64_t *) malloc(s->words * sizeof(uint64_t));
+    s->stamp = (unsigned *) calloc(s->words, sizeof(unsigned));
+    s->epoch = 0;
+}
+
+static void setFree(struct VertexSet *s)
+{
+    free(s->bits);
+    free(s->stamp);
+}
+
+static inline void setClear(struct VertexSet *s)
+{
+    if(++s->epoch == 0) {
+        memset(s->stamp, 0, s->words * sizeof(unsigned));
+        s->epoch = 1;
+    }
+}
+
+static inline uint64_t setWord(struct VertexSet *s, int w)
+{
+    return s->stamp[w] == s->epoch ? s->bits[w] : 0;
+}
+
+static inline int setHas(struct VertexSet *s, int v)
+{
+    return (setWord(s, v >> 6) >> (v & 63)) & 1;
+}
+
+static inline void setAdd(struct VertexSet *s, int v)
+{
+    int w = v >> 6;
+    if(s->stamp[w] != s->epoch) {
+        s->stamp[w] = s->epoch;
+        s->bits[w] = 0;
+    }
+    s->bits[w] |= (uint64_t) 1 << (v & 63);
+}
+
+/* The residual graph in compressed sparse row form.  Every edge owns
+   a forward arc and a reverse arc; the arcs leaving vertex v are
+   first[v] .. first[v+1]-1, and arc a runs to head[a] with residual
+   capacity residual[a] and is paired with arc rev[a].  The residual
+   capacities and excesses are arrays of the graph's capacity type. */
+struct Residual {
     int numVertices;
+    int numArcs;
+    int *first;
+    int *head;
+    int *rev;
+    void *residual;
+    int *edgeArc;      /* Forward arc of each edge, in insertion order */
+    /* Per-vertex work space for the solvers, allocated along with the
+       arcs so that solving never allocates: SCRATCH_INTS ints and one
+       excess for every vertex. */
+    int *scratch;
+    void *excess;
+    /* Visited sets for the augmenting path search. */
+    struct VertexSet seen;
+    struct VertexSet backSeen;
+    struct VertexSet frontier;
+    int cutKnown;      /* seen holds the source side of a minimum cut */
+    struct SolveStats *stats;  /* The owning graph's counters */
+    struct Limits *limits;
+    /* The residual id of each of the numIds vertex ids the edges use,
+       if the vertices were renumbered, or NULL. */
+    int *order;
+    int numIds;
+    /* With terminal sets, SOURCE_ID and SINK_ID are a virtual source
+       and sink, joined to the numSources sources and the other
+       terminals by the numTerminalArcs arc pairs after all the edges'
+       arcs.  Pair j joins terminal terminalOf[j] and has capacity
+       terminalCapacity[j]; the pairs of a terminal are consecutive.
+       The capacities of the edges at the vertex of terminal k total
+       terminalTotal[k], and its arcs were sized for terminalSized[k].
+       See sizeTerminals(). */
+    int numTerminals;
+    int numSources;
+    int numTerminalArcs;
+    int *terminalOf;
+    double *terminalCapacity;
+    double *terminalTotal;
+    double *terminalSized;
+    /* If the edges have costs, the cost of every arc, the negated cost
+       of its edge on a reverse arc, and the vertex potentials and
+       distances of the min-cost solver; otherwise NULL. */
+    double *arcCost;
+    double *potential;
+    const struct ArcScan *scan;  /* The kernels for this processor */
+};
+
+#define SCRATCH_INTS 7
+
+/* The solvers and conversions for one capacity type; see
+   flowgraph_impl.h. */
+struct Engine {
+    size_t capSize;            /* Size of a residual capacity */
+    double capMax;             /* Largest residual capacity, as a double */
+    size_t sumSize;            /* Size of an excess */
+    void (*loadArcs)(FlowGraph g, struct Residual *r);
+    void (*storeFlows)(FlowGraph g, struct Residual *r);
+    void (*storeCapacities)(FlowGraph g, struct Residual *r);
+    double (*arcValue)(struct Residual *r, int arc);
+    void (*getFlows)(FlowGraph g, void *flows, CapacityType type);
+    void (*setCapacity)(FlowGraph g, int index, double capacity);
+    void (*resetFlows)(FlowGraph g);
+    void (*findCut)(FlowGraph g);
+    double (*maxflow)(FlowGraph g);
+    double (*maxflowBidirectional)(FlowGraph g);
+    double (*maxflowScaling)(FlowGraph g);
+    double (*maxflowPushRelabel)(FlowGraph g);
+    double (*maxflowParallel)(FlowGraph g);
+    double (*maxflowDinic)(FlowGraph g);
+    double (*maxflowMinCost)(FlowGraph g);
+};
+
+struct Graph {
+    /* The edges in insertion order, an array per field with room for
+       edgeSlots.  Capacities and flows are kept as doubles, which hold
+       every value of each capacity type exactly (64-bit integers up to
+       2^53), and converted to the graph's type in the residual graph.
+       In compact mode the residual graph stands in for all four while
+       it exists, and they are NULL; see dropEdges(). */
+    int *from;
+    int *to;
+    double *capacity;
+    double *flow;
+    int edgeSlots;
+    /* Maps (from, to) to one more than the index of the first edge
+       added with those ends, each edge leading to the next by parallel
+       or to -1; both are built on the first lookup. */
+    TableFixed_T edges;
+    int *parallel;
+    int compact;            /* See Graph_setCompact() */
+    int numVertices;        /* One more than the highest vertex id */
+    /* The caller's ids of the source and sink.  Internally they are
+       SOURCE_ID and SINK_ID, and the vertices those ids would name
+       take their places. */
+    int source;
+    int sink;
     int numEdges;
+    int threads;            /* For the parallel solver; 0 for one per processor */
+    int reduce;             /* Solve through a reduced copy of the graph */
+    VertexOrder ordering;   /* For the residual graph */
+    /* Internal ids of the sources, then the sinks, that solves run
+       between in place of the terminals, if numTerminals > 0. */
+    int *terminals;
+    int numTerminals;
+    int numSources;
+    /* The cost of each edge, by index, once any cost has been set. */
+    double *cost;
+    CapacityType type;
+    const struct Engine *engine;
+    /* Built on the first solve and kept until the topology changes,
+       so repeated solves reuse the same arcs. */
+    struct Residual *residual;
+    struct SolveStats stats;
+    struct Limits limits;
 };
 
+static void releaseResidual(FlowGraph g);
+static int terminalTotals(FlowGraph g, double *total);
+static void sizeTerminals(FlowGraph g, struct Residual *r);
+static void freeResidual(struct Residual *r);
+static void restoreEdges(FlowGraph g);
+static void buildArcs(FlowGraph g, struct Residual *r);
+static const struct Engine *engineFor(CapacityType type);
+
 
 FlowGraph Graph_new(int numVertices, int numEdges)
+{
+    return Graph_newTyped(numVertices, numEdges, CAP_FLOAT);
+}
+
+FlowGraph Graph_newTyped(int numVertices, int numEdges, CapacityType type)
 {
     FlowGraph g = (FlowGraph) malloc(sizeof(*g));
-    g->vertices = TableFixed_new(numVertices, sizeof(int));
-    g->edges = TableFixed_new(numEdges, 2 * sizeof(int));
+    if(!g)
+        return NULL;
+    g->edgeSlots = numEdges > 0 ? numEdges : EDGE_ALLOC;
+    g->from = (int *) malloc(g->edgeSlots * sizeof(int));
+    g->to = (int *) malloc(g->edgeSlots * sizeof(int));
+    g->capacity = (double *) malloc(g->edgeSlots * sizeof(double));
+    g->flow = (double *) malloc(g->edgeSlots * sizeof(double));
+    if(!g->from || !g->to || !g->capacity || !g->flow) {
+        free(g->from);
+        free(g->to);
+        free(g->capacity);
+        free(g->flow);
+        free(g);
+        return NULL;
+    }
+    g->edges = NULL;
+    g->parallel = NULL;
+    g->compact = 0;
     g->numVertices = 0;
     g->numEdges = 0;
+    g->threads = 0;
+    g->reduce = 0;
+    g->ordering = ORDER_NONE;
+    g->terminals = NULL;
+    g->numTerminals = 0;
+    g->numSources = 0;
+    g->cost = NULL;
+    g->source = SOURCE_ID;
+    g->sink = SINK_ID;
+    g->type = type;
+    g->engine = engineFor(type);
+    g->residual = NULL;
+    memset(&g->stats, 0, sizeof(g->stats));
+    memset(&g->limits, 0, sizeof(g->limits));
     return g;
 }
 
 void Graph_free(FlowGraph g)
 {
-    struct Vertex *v;
-    TableFixedIter_T iter = TableFixedIter_new(g->vertices);
-    TableFixedIter_selectFirst(iter);
-    while(TableFixedIter_valid(iter)) {
-        v = (struct Vertex *) TableFixedIter_selectedValue(iter);
-        free(v->edges);
-        free(v);
-        free((void *)TableFixedIter_selectedKey(iter));
-        TableFixedIter_selectNext(iter);
-    }
-    TableFixedIter_free(iter);
-    TableFixed_free(g->vertices);
-
-    iter = TableFixedIter_new(g->edges);
-    TableFixedIter_selectFirst(iter);
-    while(TableFixedIter_valid(iter)) {
-        free(TableFixedIter_selectedValue(iter));
-        free((void *)TableFixedIter_selectedKey(iter));
-        TableFixedIter_selectNext(iter);
-    }
-    TableFixedIter_free(iter);
-    TableFixed_free(g->edges);
+    if(g->residual)
+        freeResidual(g->residual);
+    if(g->edges)
+        TableFixed_free(g->edges);
+    free(g->from);
+    free(g->to);
+    free(g->capacity);
+    free(g->flow);
+    free(g->parallel);
+    free(g->terminals);
+    free(g->cost);
     free(g);
 }
 
-static struct Vertex *addVertex(FlowGraph g, int id)
-{
-    struct Vertex *v;
-    int *key;
-    v = (struct Vertex *) TableFixed_getValue(g->vertices, &id);
-    if(!v) {
-        key = (int *) malloc(sizeof(*key));
-        *key = id;
-        v = (struct Vertex *) malloc(sizeof(*v));
-        v->id = id;
-        v->degree = 0;
-        v->slots = DEGREE_ALLOC;
-        v->edges = (struct Edge **) malloc(v->slots * sizeof(struct Edge *));
-        v->predEdge = NULL;
-        TableFixed_put(g->vertices, key, v);
-        if(id == SOURCE_ID)
-            g->source = v;
-        else if(id == SINK_ID)
-            g->sink = v;
-        g->numVertices++;
+static inline int swapIds(int v, int a, int b)
+{
+    return v == a ? b : v == b ? a : v;
+}
+
+/* Translates between the caller's vertex ids and the internal ones. */
+static inline int internalId(FlowGraph g, int v)
+{
+    return swapIds(swapIds(v, SOURCE_ID, g->source), SINK_ID,
+                   swapIds(g->sink, SOURCE_ID, g->source));
+}
+
+static inline int externalId(FlowGraph g, int v)
+{
+    return swapIds(swapIds(v, SINK_ID, swapIds(g->sink, SOURCE_ID, g->source)),
+                   SOURCE_ID, g->source);
+}
+
+int Graph_setTerminals(FlowGraph g, int source, int sink)
+{
+    if(g->numEdges > 0 || source < 0 || sink < 0 || source == sink)
+        return 0;
+    g->source = source;
+    g->sink = sink;
+    return 1;
+}
+
+static int compareInts(const void *x, const void *y);
+
+int Graph_setSolveTerminals(FlowGraph g, const int *sources, int numSources,
+                            const int *sinks, int numSinks)
+{
+    int n = Graph_numVertices(g), count = numSources + numSinks, i, *terminals;
+
+    if(numSources == 0 && numSinks == 0) {
+        sources = &g->source;
+        sinks = &g->sink;
+        numSources = numSinks = 1;
+        count = 2;
     }
-    return v;
+    if(numSources < 1 || numSinks < 1)
+        return 0;
+    terminals = (int *) malloc(count * sizeof(int));
+    for(i = 0; i < count; i++)
+        terminals[i] = i < numSources ? sources[i] : sinks[i - numSources];
+    /* Check for repeated or missing vertices in a sorted copy. */
+    qsort(terminals, count, sizeof(int), compareInts);
+    for(i = 0; i < count; i++) {
+        if(terminals[i] < 0 || terminals[i] >= n || (i > 0 && terminals[i] == terminals[i - 1])) {
+            free(terminals);
+            return 0;
+        }
+    }
+    for(i = 0; i < count; i++)
+        terminals[i] = internalId(g, i < numSources ? sources[i] : sinks[i - numSources]);
+
+    /* The graph's own terminals need no virtual ones. */
+    if(count == 2 && terminals[0] == SOURCE_ID && terminals[1] == SINK_ID) {
+        free(terminals);
+        terminals = NULL;
+        count = numSources = 0;
+    }
+    if(count == g->numTerminals && numSources == g->numSources &&
+       (count == 0 || memcmp(terminals, g->terminals, count * sizeof(int)) == 0)) {
+        free(terminals);
+        return 1;
+    }
+    /* The flow for other terminals is no flow for these.  As many new
+       terminals fit the arrays of the old ones, so unless the ordering
+       depends on them only the arcs need laying out again. */
+    if(!g->residual || g->ordering != ORDER_NONE || count != g->numTerminals ||
+       numSources != g->numSources)
+        releaseResidual(g);
+    free(g->terminals);
+    g->terminals = terminals;
+    g->numTerminals = count;
+    g->numSources = numSources;
+    if(g->residual) {
+        restoreEdges(g);
+        if(terminalTotals(g, g->residual->terminalTotal) == g->residual->numTerminalArcs) {
+            sizeTerminals(g, g->residual);
+            buildArcs(g, g->residual);
+        } else
+            releaseResidual(g);
+    }
+    Graph_resetFlows(g);
+    return 1;
+}
+
+void Graph_getTerminals(FlowGraph g, int *source, int *sink)
+{
+    *source = g->source;
+    *sink = g->sink;
+}
+
+/* Reallocates p to size bytes unless an earlier array failed to grow,
+   keeping p and clearing *ok if this one does. */
+static void *growArray(void *p, size_t size, int *ok)
+{
+    void *q;
+    if(!*ok || !p)
+        return p;
+    if(!(q = realloc(p, size)))
+        *ok = 0;
+    return q ? q : p;
+}
+
+/* Makes room in the edge arrays for count more edges.  Returns 0,
+   leaving the graph as it was, if it would pass GRAPH_MAX_EDGES or the
+   arrays cannot grow. */
+static int reserveEdges(FlowGraph g, int count)
+{
+    size_t slots = g->edgeSlots, needed = (size_t) g->numEdges + count;
+    int ok = 1;
+    if(count > GRAPH_MAX_EDGES - g->numEdges)
+        return 0;
+    if(slots >= needed)
+        return 1;
+    /* Double the size of the allocated arrays for future additions. */
+    while(slots < needed)
+        slots *= 2;
+    if(slots > GRAPH_MAX_EDGES)
+        slots = GRAPH_MAX_EDGES;
+    g->from = (int *) growArray(g->from, slots * sizeof(int), &ok);
+    g->to = (int *) growArray(g->to, slots * sizeof(int), &ok);
+    g->capacity = (double *) growArray(g->capacity, slots * sizeof(double), &ok);
+    g->flow = (double *) growArray(g->flow, slots * sizeof(double), &ok);
+    g->parallel = (int *) growArray(g->parallel, slots * sizeof(int), &ok);
+    g->cost = (double *) growArray(g->cost, slots * sizeof(double), &ok);
+    /* Arrays that did grow only have room to spare. */
+    if(ok)
+        g->edgeSlots = (int) slots;
+    return ok;
+}
+
+/* Every edge gets arcs of its own, so parallel edges need nothing more
+   than a place on the chain of the first one for lookups. */
+static void indexEdge(FlowGraph g, int i)
+{
+    int key[] = {g->from[i], g->to[i]}, first;
+    g->parallel[i] = -1;
+    if(!TableFixed_put(g->edges, key, (void *) (intptr_t) (i + 1))) {
+        first = (int) (intptr_t) TableFixed_getValue(g->edges, key) - 1;
+        g->parallel[i] = g->parallel[first];
+        g->parallel[first] = i;
+    }
+}
+
+/* Returns the index of the first edge added from from to to, in the
+   caller's ids, or -1.  The table is only built once it is needed, so
+   that bulk loads that never look up an edge do not pay for it. */
+static int findEdge(FlowGraph g, int from, int to)
+{
+    int key[] = {internalId(g, from), internalId(g, to)}, i;
+    if(!g->edges) {
+        restoreEdges(g);
+        g->edges = TableFixed_new(g->numEdges, 2 * sizeof(int));
+        g->parallel = (int *) malloc(g->edgeSlots * sizeof(int));
+        for(i = 0; i < g->numEdges; i++)
+            indexEdge(g, i);
+    }
+    return (int) (intptr_t) TableFixed_getValue(g->edges, key) - 1;
+}
+
+/* Clamps capacity to the range of the capacity type, which the
+   conversions to it need. */
+static double fitCapacity(FlowGraph g, double capacity)
+{
+    if(Graph_capacityFits(g, capacity))
+        return capacity;
+    if(capacity != capacity)
+        return 0.0;
+    return capacity > 0 ? g->engine->capMax : -g->engine->capMax;
+}
+
+static void insertEdge(FlowGraph g, int from, int to, double capacity)
+{
+    int i = g->numEdges++;
+    from = internalId(g, from);
+    to = internalId(g, to);
+    g->from[i] = from;
+    g->to[i] = to;
+    g->capacity[i] = fitCapacity(g, capacity);
+    g->flow[i] = 0.0;
+    if(g->edges)
+        indexEdge(g, i);
+    if(g->cost)
+        g->cost[i] = 0.0;
+
+    if(from >= g->numVertices)
+        g->numVertices = from + 1;
+    if(to >= g->numVertices)
+        g->numVertices = to + 1;
+}
+
+int Graph_addEdge(FlowGraph g, int from, int to, double capacity)
+{
+    /* Move the flows onto the edges, so that the residual graph can be
+       rebuilt with the new arcs on the next solve. */
+    releaseResidual(g);
+    if(!reserveEdges(g, 1))
+        return 0;
+    insertEdge(g, from, to, capacity);
+    return 1;
+}
+
+int Graph_addEdges(FlowGraph g, const int *from, const int *to,
+                   const double *capacity, int count)
+{
+    int i;
+    if(count <= 0)
+        return 1;
+    releaseResidual(g);
+    if(!reserveEdges(g, count))
+        return 0;
+    for(i = 0; i < count; i++)
+        insertEdge(g, from[i], to[i], capacity[i]);
+    return 1;
+}
+
+static inline double capacityAt(const void *capacity, CapacityType type, int64_t i)
+{
+    switch(type) {
+    case CAP_DOUBLE: return ((const double *) capacity)[i];
+    case CAP_INT32:  return ((const int32_t *) capacity)[i];
+    case CAP_INT64:  return ((const int64_t *) capacity)[i];
+    default:         return ((const float *) capacity)[i];
+    }
+}
+
+int Graph_addEdgesCSR(FlowGraph g, int numTails, const int64_t *first,
+                      const int *heads, const void *capacity, CapacityType type)
+{
+    int64_t i, count = first[numTails] - first[0];
+    int v;
+    if(count <= 0)
+        return 1;
+    if(count > GRAPH_MAX_EDGES)
+        return 0;
+    releaseResidual(g);
+    if(!reserveEdges(g, (int) count))
+        return 0;
+    for(v = 0; v < numTails; v++)
+        for(i = first[v]; i < first[v + 1]; i++)
+            insertEdge(g, v, heads[i], capacityAt(capacity, type, i));
+    return 1;
+}
+
+void Graph_getEdges(FlowGraph g, int *from, int *to, double *capacity)
+{
+    int i;
+    restoreEdges(g);
+    for(i = 0; i < g->numEdges; i++) {
+        if(from)
+            from[i] = externalId(g, g->from[i]);
+        if(to)
+            to[i] = externalId(g, g->to[i]);
+        if(capacity)
+            capacity[i] = g->capacity[i];
+    }
+}
+
+int Graph_numEdges(FlowGraph g)
+{
+    return g->numEdges;
+}
+
+/* Counts in the caller's ids, which can reach further than the
+   internal ones when the terminals have moved. */
+int Graph_numVertices(FlowGraph g)
+{
+    int n = g->numVertices > SINK_ID ? g->numVertices : SINK_ID + 1;
+    if(g->source >= n)
+        n = g->source + 1;
+    if(g->sink >= n)
+        n = g->sink + 1;
+    return n;
+}
+
+CapacityType Graph_capacityType(FlowGraph g)
+{
+    return g->type;
+}
+
+int Graph_capacityFits(FlowGraph g, double capacity)
+{
+    return Graph_capacityFitsType(g->type, capacity);
+}
+
+int Graph_capacityFitsType(CapacityType type, double capacity)
+{
+    double capMax = engineFor(type)->capMax;
+    if(type == CAP_FLOAT || type == CAP_DOUBLE)
+        return !(fabs(capacity) > capMax) || isinf(capacity);
+    return fabs(capacity) <= capMax;
+}
+
+double Graph_getFlow(FlowGraph g, int from, int to)
+{
+    double flow = 0.0;
+    int i;
+    for(i = findEdge(g, from, to); i >= 0; i = g->parallel[i])
+        flow += Graph_getEdgeFlow(g, i);
+    return flow;
 }
 
-static void connectVtoE(struct Vertex *v, struct Edge *e)
+double Graph_getEdgeFlow(FlowGraph g, int index)
 {
-    if(v->slots <= v->degree) {
-        /* Double the size of the allocated array for future additions. */
-        v->slots *= 2;
-        v->edges = (struct Edge **) realloc(v->edges, v->slots * sizeof(struct Edge *));
+    struct Residual *r = g->residual;
+    if(index < 0 || index >= g->numEdges)
+        return 0.0;
+    /* While the residual graph exists, the flow lives on its reverse arc. */
+    return r ? g->engine->arcValue(r, r->rev[r->edgeArc[index]]) :
+               g->flow[index];
+}
+
+void Graph_getFlows(FlowGraph g, void *flows, CapacityType type)
+{
+    g->engine->getFlows(g, flows, type);
+}
+
+static inline int residualId(struct Residual *r, int v)
+{
+    return r->order ? r->order[v] : v;
+}
+
+/* Returns the residual ids of the ends of arc pair i: edge i, or for
+   i past the edges, a terminal arc. */
+static inline void arcEnds(FlowGraph g, struct Residual *r, int i, int *from, int *to)
+{
+    int k = i < g->numEdges ? -1 : r->terminalOf[i - g->numEdges];
+    if(k < 0) {
+        *from = residualId(r, g->from[i]);
+        *to = residualId(r, g->to[i]);
+    } else if(k < r->numSources) {
+        *from = SOURCE_ID;
+        *to = residualId(r, g->terminals[k]);
+    } else {
+        *from = residualId(r, g->terminals[k]);
+        *to = SINK_ID;
     }
-    v->edges[v->degree++] = e;
 }
 
-static const void *createKey(int from, int to)
+/* Fills in the arcs of the edges and terminals with a counting sort on
+   the arc tails, numbering the vertices as r->order says. */
+static void buildArcs(FlowGraph g, struct Residual *r)
 {
-    void *key = malloc(2 * sizeof(int));
-    memcpy(key, &from, sizeof(int));
-    memcpy(key + sizeof(int), &to, sizeof(int));
-    return key;
+    int n = r->numVertices, pairs = r->numArcs / 2, i, a, b, from, to, *pos;
+
+    memset(r->first, 0, (n + 1) * sizeof(int));
+    for(i = 0; i < pairs; i++) {
+        arcEnds(g, r, i, &from, &to);
+        r->first[from + 1]++;
+        r->first[to + 1]++;
+    }
+    for(i = 0; i < n; i++)
+        r->first[i + 1] += r->first[i];
+    pos = r->scratch;
+    memcpy(pos, r->first, n * sizeof(int));
+    for(i = 0; i < pairs; i++) {
+        arcEnds(g, r, i, &from, &to);
+        a = pos[from]++;
+        b = pos[to]++;
+        r->head[a] = to;
+        r->head[b] = from;
+        r->rev[a] = b;
+        r->rev[b] = a;
+        r->edgeArc[i] = a;
+        if(r->arcCost) {
+            r->arcCost[a] = i < g->numEdges ? g->cost[i] : 0.0;
+            r->arcCost[b] = -r->arcCost[a];
+        }
+    }
 }
 
-void Graph_addEdge(FlowGraph g, int from, int to, float capacity)
+static int compareInts(const void *x, const void *y)
 {
-    struct Vertex *vfrom, *vto;
-    const void *key = createKey(from, to);
-    struct Edge *e = (struct Edge *) malloc(sizeof(*e));
-    vfrom = addVertex(g, from);
-    vto = addVertex(g, to);
+    int a = *(const int *) x, b = *(const int *) y;
+    return a < b ? -1 : a > b;
+}
 
-    e->capacity = capacity;
-    e->flow = 0.0;
-    e->from = vfrom;
-    e->to = vto;
-    e->reverseEdge = NULL;
-    TableFixed_put(g->edges, key, e);
+/* Lists all the vertices of r in breadth-first order, ignoring arc
+   directions.  Each component
+   is started from start if it is not yet listed, and otherwise from
+   the first vertex of candidates that is not.  With rank, the
+   unlisted neighbours of a vertex are listed by increasing rank, which
+   is what Cuthill-McKee needs. */
+static void breadthFirst(struct Residual *r, int start, const int *candidates,
+                         const int *rank, const int *byRank, int *list)
+{
+    int n = r->numVertices, head = 0, tail = 0, next = 0, v, a, from;
 
-    g->numEdges++;
-    connectVtoE(vfrom, e);
+    setClear(&r->seen);
+    while(tail < n) {
+        if(head == tail) {
+            if(setHas(&r->seen, start))
+                for(start = candidates[next++]; setHas(&r->seen, start);
+                    start = candidates[next++])
+                    ;
+            setAdd(&r->seen, start);
+            list[tail++] = start;
+        }
+        v = list[head++];
+        from = tail;
+        for(a = r->first[v]; a < r->first[v + 1]; a++) {
+            if(!setHas(&r->seen, r->head[a])) {
+                setAdd(&r->seen, r->head[a]);
+                list[tail++] = rank ? rank[r->head[a]] : r->head[a];
+            }
+        }
+        if(rank) {
+            qsort(list + from, tail - from, sizeof(int), compareInts);
+            for(a = from; a < tail; a++)
+                list[a] = byRank[list[a]];
+        }
+    }
 }
 
-float Graph_getFlow(FlowGraph g, int from, int to)
+/* Renumbers the vertices of r, whose arcs are in place, in the given
+   order while keeping the terminals at SOURCE_ID and SINK_ID. */
+static void orderVertices(struct Residual *r, VertexOrder ordering)
 {
-    int key[] = {from, to};
-    return ((struct Edge *) TableFixed_getValue(g->edges, key))->flow;
+    int n = r->numVertices, *list = r->scratch, *byRank = list + n,
+        *rank = byRank + n, *perm = rank + n, *count, i, v, maxDegree = 0;
+
+    if(ordering == ORDER_BFS) {
+        for(v = 0; v < n; v++)
+            byRank[v] = v;
+        breadthFirst(r, SOURCE_ID, byRank, NULL, NULL, list);
+    } else {
+        /* Rank the vertices by degree, starting each component from
+           a vertex of the lowest degree, and reverse the result. */
+        for(v = 0; v < n; v++)
+            if((r->first[v + 1] - r->first[v]) > maxDegree)
+                maxDegree = (r->first[v + 1] - r->first[v]);
+        count = (int *) calloc(maxDegree + 2, sizeof(int));
+        for(v = 0; v < n; v++)
+            count[(r->first[v + 1] - r->first[v]) + 1]++;
+        for(i = 0; i <= maxDegree; i++)
+            count[i + 1] += count[i];
+        for(v = 0; v < n; v++) {
+            rank[v] = count[(r->first[v + 1] - r->first[v])]++;
+            byRank[rank[v]] = v;
+        }
+        free(count);
+        breadthFirst(r, byRank[0], byRank, rank, byRank, list);
+        for(i = 0; i < n / 2; i++) {
+            v = list[i];
+            list[i] = list[n - 1 - i];
+            list[n - 1 - i] = v;
+        }
+    }
+
+    perm[SOURCE_ID] = SOURCE_ID;
+    perm[SINK_ID] = SINK_ID;
+    for(i = 0, v = SINK_ID + 1; i < n; i++)
+        if(list[i] != SOURCE_ID && list[i] != SINK_ID)
+            perm[list[i]] = v++;
+    for(v = 0; v < r->numIds; v++)
+        r->order[v] = perm[r->order[v]];
+}
+
+/* Adds up into total the capacities of the edges at the vertex of each
+   terminal, plus one, and returns how many arcs of the capacity type it
+   takes to carry that much from all the terminals. */
+static int terminalTotals(FlowGraph g, double *total)
+{
+    int *slot = (int *) calloc(Graph_numVertices(g), sizeof(int)), i, k, count = 0;
+    for(k = 0; k < g->numTerminals; k++) {
+        slot[g->terminals[k]] = k + 1;
+        total[k] = 1;
+    }
+    for(i = 0; i < g->numEdges; i++) {
+        if(g->capacity[i] <= 0 || g->from[i] == g->to[i])
+            continue;
+        if(slot[g->from[i]])
+            total[slot[g->from[i]] - 1] += g->capacity[i];
+        if(slot[g->to[i]])
+            total[slot[g->to[i]] - 1] += g->capacity[i];
+    }
+    free(slot);
+    for(k = 0; k < g->numTerminals; k++)
+        count += (int) ceil(total[k] / g->engine->capMax);
+    return count;
+}
+
+/* The flow through a terminal's arcs is never more than the edges at
+   its vertex can carry, so arcs adding up to their total capacity are
+   never the bottleneck.  Where one arc cannot hold that much, the
+   terminal gets several, parallel ones.  terminalTotal must be filled
+   in, and numTerminalArcs be its count. */
+static void sizeTerminals(FlowGraph g, struct Residual *r)
+{
+    double rest;
+    int j = 0, k;
+    for(k = 0; k < g->numTerminals; k++) {
+        r->terminalSized[k] = r->terminalTotal[k];
+        for(rest = r->terminalTotal[k]; rest > 0; rest -= g->engine->capMax, j++) {
+            r->terminalOf[j] = k;
+            r->terminalCapacity[j] = MIN(rest, g->engine->capMax);
+        }
+    }
+}
+
+/* Builds the residual graph from the edges and their current flows. */
+static struct Residual *freeze(FlowGraph g)
+{
+    struct Residual *r = (struct Residual *) malloc(sizeof(*r));
+    int n, v;
+
+    /* The terminals always exist, even in a graph without edges. */
+    n = r->numIds = Graph_numVertices(g);
+    r->order = NULL;
+    if(g->numTerminals) {
+        /* Make room for the virtual terminals. */
+        r->order = (int *) malloc(n * sizeof(int));
+        for(v = 0; v < n; v++)
+            r->order[v] = v + SINK_ID + 1;
+        n += SINK_ID + 1;
+    }
+    r->numVertices = n;
+    r->numTerminals = g->numTerminals;
+    r->numSources = g->numSources;
+    r->numTerminalArcs = 0;
+    r->terminalOf = NULL;
+    r->terminalCapacity = NULL;
+    r->terminalTotal = NULL;
+    if(g->numTerminals) {
+        r->terminalTotal = (double *) malloc(2 * g->numTerminals * sizeof(double));
+        r->terminalSized = r->terminalTotal + g->numTerminals;
+        r->numTerminalArcs = terminalTotals(g, r->terminalTotal);
+        r->terminalOf = (int *) malloc(r->numTerminalArcs * sizeof(int));
+        r->terminalCapacity = (double *) malloc(r->numTerminalArcs * sizeof(double));
+        sizeTerminals(g, r);
+    }
+    r->numArcs = 2 * (g->numEdges + r->numTerminalArcs);
+    r->first = (int *) malloc((n + 1) * sizeof(int));
+    r->head = (int *) malloc(r->numArcs * sizeof(int));
+    r->rev = (int *) malloc(r->numArcs * sizeof(int));
+    r->residual = malloc(r->numArcs * g->engine->capSize);
+    r->edgeArc = (int *) malloc(r->numArcs / 2 * sizeof(int));
+    r->scratch = (int *) malloc(SCRATCH_INTS * n * sizeof(int));
+    r->excess = malloc(n * g->engine->sumSize);
+    setInit(&r->seen, n);
+    setInit(&r->backSeen, n);
+    setInit(&r->frontier, n);
+    r->cutKnown = 0;
+    r->stats = &g->stats;
+    r->limits = &g->limits;
+    r->scan = ArcScan_select();
+    r->arcCost = NULL;
+    r->potential = NULL;
+    if(g->cost) {
+        r->arcCost = (double *) malloc(r->numArcs * sizeof(double));
+        r->potential = (double *) malloc(2 * n * sizeof(double));
+    }
+
+    buildArcs(g, r);
+    if(g->ordering != ORDER_NONE) {
+        if(!r->order) {
+            r->order = (int *) malloc(r->numIds * sizeof(int));
+            for(v = 0; v < r->numIds; v++)
+                r->order[v] = v;
+        }
+        orderVertices(r, g->ordering);
+        buildArcs(g, r);
+    }
+    g->engine->loadArcs(g, r);
+    return r;
+}
+
+/* Returns the residual graph for changing the flow, which also
+   invalidates the minimum cut found for the old flow. */
+static struct Residual *residualOf(FlowGraph g)
+{
+    if(!g->residual)
+        g->residual = freeze(g);
+    g->residual->cutKnown = 0;
+    return g->residual;
+}
+
+static void freeResidual(struct Residual *r)
+{
+    free(r->first);
+    free(r->head);
+    free(r->rev);
+    free(r->residual);
+    free(r->edgeArc);
+    free(r->scratch);
+    free(r->excess);
+    free(r->order);
+    free(r->arcCost);
+    free(r->potential);
+    free(r->terminalOf);
+    free(r->terminalCapacity);
+    free(r->terminalTotal);
+    setFree(&r->seen);
+    setFree(&r->backSeen);
+    setFree(&r->frontier);
+    free(r);
+}
+
+/* Puts back the edge arrays that compact mode dropped.  The reverse arc
+   of every edge runs back to its tail and holds its flow, and the two
+   arcs hold its capacity between them. */
+static void restoreEdges(FlowGraph g)
+{
+    struct Residual *r = g->residual;
+    int *internal = NULL, i, a, v;
+    if(g->from)
+        return;
+    g->from = (int *) malloc(g->edgeSlots * sizeof(int));
+    g->to = (int *) malloc(g->edgeSlots * sizeof(int));
+    g->capacity = (double *) malloc(g->edgeSlots * sizeof(double));
+    g->flow = (double *) malloc(g->edgeSlots * sizeof(double));
+    if(r->order) {
+        internal = (int *) malloc(r->numVertices * sizeof(int));
+        for(v = 0; v < r->numIds; v++)
+            internal[r->order[v]] = v;
+    }
+    for(i = 0; i < g->numEdges; i++) {
+        a = r->edgeArc[i];
+        g->from[i] = internal ? internal[r->head[r->rev[a]]] : r->head[r->rev[a]];
+        g->to[i] = internal ? internal[r->head[a]] : r->head[a];
+    }
+    free(internal);
+    g->engine->storeCapacities(g, r);
+    g->engine->storeFlows(g, r);
+}
+
+/* Leaves a solved graph in compact mode with nothing of its edges but
+   the arcs. */
+static void dropEdges(FlowGraph g)
+{
+    if(!g->compact || !g->residual || !g->from)
+        return;
+    free(g->from);
+    free(g->to);
+    free(g->capacity);
+    free(g->flow);
+    g->from = g->to = NULL;
+    g->capacity = g->flow = NULL;
+}
+
+/* Copies the flows back onto the edges and frees the residual graph. */
+static void releaseResidual(FlowGraph g)
+{
+    struct Residual *r = g->residual;
+    if(!r)
+        return;
+    if(g->from)
+        g->engine->storeFlows(g, r);
+    else
+        restoreEdges(g);
+    freeResidual(r);
+    g->residual = NULL;
 }
 
 /* --------------------------------------------------------------------------- */
-/* maxflow algorithm here is an adaptation of the Ford-Fulkerson
-   algorithm as presented in
-   http://www.aduni.org/courses/algorithms/courseware/handouts/Reciation_09.html. */
-
-struct MaxFlowInfo {
-    /* Keeps a handle on edges created only for maxflow computation so
-       we can free them when done. */
-    struct Edge **reverseEdges;
-    int numReverseEdges;
-    /* Queue for implementing BFS. */
-    struct Vertex **queue;
-    int head;
-    int tail;
-    int *visited;
+/* Helpers shared by every capacity type. */
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Counts an iteration of the running solve and returns 1 if a bound
+   says it must stop instead.  The clock is read every few iterations,
+   as set by every, a power of two.  Outside a solve nothing is bounded,
+   so that flow repairs always finish. */
+static int limitReached(struct Residual *r, long every)
+{
+    struct Limits *l = r->limits;
+    long i = r->stats->iterations;
+
+    if(!l->active)
+        return 0;
+    if(l->stopped)
+        return 1;
+    if((l->cancel && __atomic_load_n(l->cancel, __ATOMIC_RELAXED)) ||
+       (l->iterations > 0 && i >= l->iterations) ||
+       (l->seconds > 0 && (i & (every - 1)) == 0 && now() > l->deadline)) {
+        l->stopped = 1;
+        return 1;
+    }
+    r->stats->iterations = i + 1;
+    return 0;
+}
+
+static inline int degree(struct Residual *r, int v)
+{
+    return r->first[v + 1] - r->first[v];
+}
+
+/* The searches test the arcs of a vertex with at least SCAN_DEGREE of
+   them for residual capacity SCAN_WIDTH at a time, with the widest
+   ArcScan kernels the processor has, and only look further at the arcs
+   that pass. */
+#define SCAN_DEGREE 16
+#define SCAN_WIDTH  64
+
+/* Go bottom-up when a growing frontier has more than 1/ALPHA of the
+   unexplored arcs, and back when it has fewer than n/BETA vertices.
+   ALPHA is much smaller than for plain BFS: the search stops at the
+   sink, which favours top-down steps. */
+#define BOTTOM_UP_ALPHA 2
+#define BOTTOM_UP_BETA  24
+
+/* Push-relabel runs a global relabel once FREQ times the relabel work
+   since the last one exceeds ALPHA per vertex plus one per arc; BETA
+   is charged for each relabel on top of the arcs it scans. */
+#define GLOBAL_RELABEL_ALPHA 6
+#define GLOBAL_RELABEL_BETA  12
+#define GLOBAL_RELABEL_FREQ  0.5
+
+/* Vertices a thread takes at a time from a parallel BFS frontier. */
+#define BFS_CHUNK 64
+
+/* Per-worker queue of active vertices for the parallel solver. */
+struct WorkQueue {
+    pthread_mutex_t lock;
+    int *items;
+    int top;                   /* Stolen from */
+    int bottom;                /* Pushed and popped by the owner */
+    int size;
 };
 
-#define WHITE 0
-#define GRAY  1
-#define BLACK 2
+/* Minimal reusable barrier; pthread barriers are not available
+   everywhere. */
+struct Barrier {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+    int waiting;
+    int cycle;
+};
+
+static void barrierWait(struct Barrier *b)
+{
+    int cycle;
+    pthread_mutex_lock(&b->lock);
+    cycle = b->cycle;
+    if(++b->waiting == b->count) {
+        b->waiting = 0;
+        b->cycle++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while(cycle == b->cycle)
+            pthread_cond_wait(&b->cond, &b->lock);
+    }
+    pthread_mutex_unlock(&b->lock);
+}
 
-static inline void enqueue(struct MaxFlowInfo *mfi, struct Vertex *v)
+static void queuePush(struct WorkQueue *q, int v)
 {
-    mfi->queue[mfi->tail++] = v;
-    mfi->visited[v->id] = 1;
+    pthread_mutex_lock(&q->lock);
+    if(q->bottom == q->size) {
+        if(q->top > 0) {
+            memmove(q->items, q->items + q->top, (q->bottom - q->top) * sizeof(int));
+            q->bottom -= q->top;
+            q->top = 0;
+        }
+        if(q->bottom == q->size) {
+            q->size = q->size ? 2 * q->size : 1024;
+            q->items = (int *) realloc(q->items, q->size * sizeof(int));
+        }
+    }
+    q->items[q->bottom++] = v;
+    pthread_mutex_unlock(&q->lock);
 }
 
-static inline struct Vertex *dequeueBFS(struct MaxFlowInfo *mfi)
+/* Takes the newest vertex of the owner's queue, or the oldest one of a
+   victim's queue when stealing.  Returns -1 if the queue is empty. */
+static int queueTake(struct WorkQueue *q, int steal)
 {
-    /* Not really a queue; it's a stack! */
-    struct Vertex *v = mfi->queue[mfi->head++];
-    mfi->visited[v->id] = BLACK;
+    int v = -1;
+    pthread_mutex_lock(&q->lock);
+    if(q->bottom > q->top)
+        v = steal ? q->items[q->top++] : q->items[--q->bottom];
+    if(q->bottom == q->top)
+        q->bottom = q->top = 0;
+    pthread_mutex_unlock(&q->lock);
     return v;
 }
 
-static inline struct Vertex *dequeueDFS(struct MaxFlowInfo *mfi)
+/* Relaxations of a min-cost search must gain more than this, relative
+   to the distance, so that rounding cannot make a cycle look negative. */
+#define COST_EPSILON 1e-12
+
+/* Binary heap of vertices by key[v] for Dijkstra's algorithm; pos[v] is
+   the place of v in item, or -1 if v is not in the heap. */
+struct Heap {
+    int *item;
+    int *pos;
+    int size;
+    const double *key;
+};
+
+static void heapUp(struct Heap *h, int i)
+{
+    int v = h->item[i], p;
+    while(i > 0 && h->key[h->item[p = (i - 1) / 2]] > h->key[v]) {
+        h->item[i] = h->item[p];
+        h->pos[h->item[i]] = i;
+        i = p;
+    }
+    h->item[i] = v;
+    h->pos[v] = i;
+}
+
+static void heapDown(struct Heap *h, int i)
 {
-    /* Not really a queue; it's a stack! */
-    struct Vertex *v = mfi->queue[--mfi->tail];
-    mfi->visited[v->id] = BLACK;
+    int v = h->item[i], c;
+    while((c = 2 * i + 1) < h->size) {
+        if(c + 1 < h->size && h->key[h->item[c + 1]] < h->key[h->item[c]])
+            c++;
+        if(h->key[h->item[c]] >= h->key[v])
+            break;
+        h->item[i] = h->item[c];
+        h->pos[h->item[i]] = i;
+        i = c;
+    }
+    h->item[i] = v;
+    h->pos[v] = i;
+}
+
+/* Adds v, or moves it up once its key has dropped. */
+static void heapUpdate(struct Heap *h, int v)
+{
+    if(h->pos[v] < 0) {
+        h->item[h->size] = v;
+        h->pos[v] = h->size++;
+    }
+    heapUp(h, h->pos[v]);
+}
+
+static int heapPop(struct Heap *h)
+{
+    int v = h->item[0];
+    h->pos[v] = -1;
+    if(--h->size > 0) {
+        h->item[0] = h->item[h->size];
+        heapDown(h, 0);
+    }
     return v;
 }
 
-static inline int findPath(FlowGraph g, struct MaxFlowInfo *mfi)
+#define PASTE(name, suffix) PASTE2(name, suffix)
+#define PASTE2(name, suffix) name##_##suffix
+
+#define CAP float
+#define SUM float
+#define CAP_MAX FLT_MAX
+#define CAP_LIMIT FLT_MAX
+#define SUM_MAX FLT_MAX
+#define SUFFIX float
+#include "flowgraph_impl.h"
+
+#define CAP double
+#define SUM double
+#define CAP_MAX DBL_MAX
+#define CAP_LIMIT DBL_MAX
+#define SUM_MAX DBL_MAX
+#define SUFFIX double
+#include "flowgraph_impl.h"
+
+/* Integer flows are summed in 64 bits, so that the flow value cannot
+   overflow the capacity type. */
+#define CAP int32_t
+#define SUM int64_t
+#define CAP_MAX INT32_MAX
+#define CAP_LIMIT 2147483647.0
+#define SUM_MAX INT64_MAX
+#define SUFFIX int32
+#include "flowgraph_impl.h"
+
+#define CAP int64_t
+#define SUM int64_t
+#define CAP_MAX INT64_MAX
+#define CAP_LIMIT 9223372036854774784.0  /* The last double below 2^63 */
+#define SUM_MAX INT64_MAX
+#define SUFFIX int64
+#include "flowgraph_impl.h"
+
+static const struct Engine *engineFor(CapacityType type)
 {
-    struct Vertex *u, *v;
-    struct Edge *e;
-    int i;
-    /* Zero the visited array to all WHITE. */
-    memset(mfi->visited, 0, g->numVertices * sizeof(int));
-    mfi->head = 0;
-    mfi->tail = 0;
-    enqueue(mfi, g->source);
-    while(mfi->head != mfi->tail) {
-        u = dequeueBFS(mfi);
-        for(i = 0; i < u->degree; i++) {
-            e = u->edges[i];
-            v = e->to;
-            if(mfi->visited[v->id] == WHITE && e->capacity - e->flow > 0) {
-                enqueue(mfi, v);
-                v->predEdge = e;
-                if(v == g->sink)
-                    return 1;
+    switch(type) {
+    case CAP_DOUBLE: return &engine_double;
+    case CAP_INT32:  return &engine_int32;
+    case CAP_INT64:  return &engine_int64;
+    default:         return &engine_float;
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+/* The reduction pass solves a smaller graph in place of g.  Edges no
+   flow from the source to the sink can use are dropped, parallel edges
+   are merged into one with their capacities added, as long as the sum
+   fits the solver's type, and chains through vertices with a single
+   edge in and a single edge out become one edge with the smallest
+   capacity of the chain.  Every edge of the smaller graph is the root
+   of a tree of the edges it stands for, through which its flow is
+   handed back out. */
+
+enum { TREE_EDGE, TREE_TERMINAL, TREE_SERIES, TREE_PARALLEL };
+
+struct Reduction {
+    int numVertices;
+    int source;
+    int sink;
+    double capMax;          /* Largest capacity of the solver's type */
+    /* Tree nodes: node i < g->numEdges is edge i, terminal nodes stand
+       for the arcs from a virtual source or to a virtual sink, and the
+       others for the series or parallel group of the nodes on their
+       child list. */
+    int *kind;
+    double *capacity;
+    int *child;
+    int *sibling;
+    int numNodes;
+    /* The edges still standing. */
+    int *tail;
+    int *head;
+    int *node;
+    int count;
+    int *order;             /* Work space of 2 * numVertices + 1 ints */
+};
+
+/* The capacity an edge has in the solver's type, so that the merged
+   capacities add up to what their edges can actually carry. */
+static double solverCapacity(FlowGraph g, double capacity)
+{
+    switch(g->type) {
+    case CAP_FLOAT: return (float) capacity;
+    case CAP_INT32: return (int32_t) capacity;
+    case CAP_INT64: return (double) (int64_t) capacity;
+    default:        return capacity;
+    }
+}
+
+static int newNode(struct Reduction *red, int kind, double capacity)
+{
+    int i = red->numNodes++;
+    red->kind[i] = kind;
+    red->capacity[i] = capacity;
+    red->child[i] = -1;
+    return i;
+}
+
+static void addChild(struct Reduction *red, int parent, int child)
+{
+    red->sibling[child] = red->child[parent];
+    red->child[parent] = child;
+}
+
+static inline void keepEdge(struct Reduction *red, int tail, int head, int node)
+{
+    red->tail[red->count] = tail;
+    red->head[red->count] = head;
+    red->node[red->count] = node;
+    red->count++;
+}
+
+/* Sorts the edges by key into order with a counting sort, leaving the
+   edges with key v at order[first[v]] .. order[first[v+1]-1]. */
+static void sortEdges(struct Reduction *red, const int *key, int *first, int *order)
+{
+    int n = red->numVertices, i;
+    memset(first, 0, (n + 1) * sizeof(int));
+    for(i = 0; i < red->count; i++)
+        first[key[i] + 1]++;
+    for(i = 0; i < n; i++)
+        first[i + 1] += first[i];
+    for(i = 0; i < red->count; i++)
+        order[first[key[i]]++] = i;
+    for(i = n; i > 0; i--)
+        first[i] = first[i - 1];
+    first[0] = 0;
+}
+
+/* Marks with mark the vertices reachable from start along the edges
+   in the direction from key to other, not going through stop. */
+static void reach(struct Reduction *red, const int *key, const int *other,
+                  int start, int stop, char *seen, char mark)
+{
+    int n = red->numVertices, *first = red->order, *queue = first + n + 1,
+        *order = (int *) malloc((red->count ? red->count : 1) * sizeof(int));
+    int head = 0, tail = 0, v, i;
+
+    sortEdges(red, key, first, order);
+    seen[start] |= mark;
+    queue[tail++] = start;
+    while(head != tail) {
+        v = queue[head++];
+        if(v == stop)
+            continue;
+        for(i = first[v]; i < first[v + 1]; i++) {
+            if(!(seen[other[order[i]]] & mark)) {
+                seen[other[order[i]]] |= mark;
+                queue[tail++] = other[order[i]];
             }
         }
     }
-    return 0;
+    free(order);
+}
+
+/* Drops the edges off every path from the source to the sink. */
+static void pruneDead(struct Reduction *red)
+{
+    char *seen = (char *) calloc(red->numVertices, 1);
+    int i, count = red->count;
+
+    reach(red, red->tail, red->head, red->source, red->sink, seen, 1);
+    reach(red, red->head, red->tail, red->sink, red->source, seen, 2);
+    red->count = 0;
+    for(i = 0; i < count; i++)
+        if(seen[red->tail[i]] == 3 && seen[red->head[i]] == 3)
+            keepEdge(red, red->tail[i], red->head[i], red->node[i]);
+    free(seen);
+}
+
+/* Merges the edges with the same tail and head, into as many edges as
+   it takes to keep each capacity in the range of the solver's type. */
+static void mergeParallel(struct Reduction *red)
+{
+    int n = red->numVertices, count = red->count, i, j, k, e, p;
+    int *first = red->order, *byHead, *sorted, *tail, *head, *node;
+    double total;
+
+    if(count == 0)
+        return;
+    byHead = (int *) malloc(2 * count * sizeof(int));
+    sorted = byHead + count;
+    tail = (int *) malloc(3 * count * sizeof(int));
+    head = tail + count;
+    node = head + count;
+    memcpy(tail, red->tail, count * sizeof(int));
+    memcpy(head, red->head, count * sizeof(int));
+    memcpy(node, red->node, count * sizeof(int));
+    /* Sort by head, then stably by tail, so that equal ends are adjacent. */
+    sortEdges(red, head, first, byHead);
+    memset(first, 0, (n + 1) * sizeof(int));
+    for(i = 0; i < count; i++)
+        first[tail[i] + 1]++;
+    for(i = 0; i < n; i++)
+        first[i + 1] += first[i];
+    for(i = 0; i < count; i++) {
+        e = byHead[i];
+        sorted[first[tail[e]]++] = e;
+    }
+
+    red->count = 0;
+    for(i = 0; i < count; i = j) {
+        e = sorted[i];
+        total = red->capacity[node[e]];
+        for(j = i + 1; j < count && tail[sorted[j]] == tail[e] &&
+                       head[sorted[j]] == head[e] &&
+                       total + red->capacity[node[sorted[j]]] <= red->capMax; j++)
+            total += red->capacity[node[sorted[j]]];
+        if(j == i + 1) {
+            keepEdge(red, tail[e], head[e], node[e]);
+            continue;
+        }
+        p = newNode(red, TREE_PARALLEL, total);
+        for(k = i; k < j; k++)
+            addChild(red, p, node[sorted[k]]);
+        keepEdge(red, tail[e], head[e], p);
+    }
+    free(byHead);
+    free(tail);
 }
 
-static void addFlow(struct MaxFlowInfo *mfi, struct Edge *edge, float amount)
-{
-    struct Edge *reverse = edge->reverseEdge;
-    if(!reverse) {
-        /* Create a temporary reverse edge and add it to the list of
-           reverse edges for removal after the maxflow algorithm
-           completes. */
-        reverse = (struct Edge *) malloc(sizeof(*reverse));
-        reverse->capacity = 0.0;
-        reverse->flow = 0.0;
-        reverse->from = edge->to;
-        reverse->to = edge->from;
-        reverse->reverseEdge = edge;
-        edge->reverseEdge = reverse;
-        mfi->reverseEdges[mfi->numReverseEdges++] = reverse;
-        connectVtoE(reverse->from, reverse);
-    }
-    edge->flow += amount;
-    reverse->flow -= amount;
-}
-
-float Graph_maxflow(FlowGraph g)
-{
-    int n = g->numVertices, i;
-    struct MaxFlowInfo mfi;
-    struct Vertex *v;
-    struct Edge *e;
-    float increment, maxflowVal = 0.0;
-    mfi.visited = (int *) malloc(n * sizeof(int));
-    mfi.reverseEdges = (struct Edge **) malloc(g->numEdges * sizeof(struct Edge *));
-    mfi.numReverseEdges = 0;
-    mfi.queue = (struct Vertex **) malloc((n+2) * sizeof(struct Vertex *));
-
-    /* While there exists an augmenting path, increment the flow along
-       this path. */
-    while(findPath(g, &mfi)) {
-        /* Determine the amount by which we can increment the flow. */
-        increment = INFINITY;
-        v = g->sink;
-        while(v != g->source) {
-            increment = MIN(increment, v->predEdge->capacity - v->predEdge->flow);
-            v = v->predEdge->from;
+/* Contracts every chain of vertices with one edge in and one edge out. */
+static void contractSeries(struct Reduction *red)
+{
+    int n = red->numVertices, count = red->count, i, e, v, s;
+    int *in = red->order, *out = in + n, *tail, *head, *node;
+    double capacity;
+
+    if(count == 0)
+        return;
+    tail = (int *) malloc(3 * count * sizeof(int));
+    head = tail + count;
+    node = head + count;
+
+#define INNER(v) ((v) != red->source && (v) != red->sink && in[v] == 1 && out[v] >= 0)
+
+    memcpy(tail, red->tail, count * sizeof(int));
+    memcpy(head, red->head, count * sizeof(int));
+    memcpy(node, red->node, count * sizeof(int));
+    /* out[v] is v's only edge out, or -1 if it has none or several. */
+    for(v = 0; v < n; v++) {
+        in[v] = 0;
+        out[v] = -1;
+    }
+    for(e = 0; e < count; e++)
+        in[head[e]]++;
+    for(e = 0; e < count; e++)
+        out[tail[e]] = out[tail[e]] == -1 ? e : -2;
+    for(v = 0; v < n; v++)
+        if(out[v] < 0)
+            out[v] = -1;
+
+    red->count = 0;
+    for(e = 0; e < count; e++) {
+        if(INNER(tail[e]))
+            continue;
+        if(!INNER(head[e])) {
+            keepEdge(red, tail[e], head[e], node[e]);
+            continue;
+        }
+        s = newNode(red, TREE_SERIES, red->capacity[node[e]]);
+        addChild(red, s, node[e]);
+        capacity = red->capacity[node[e]];
+        for(v = head[e]; INNER(v); v = head[i]) {
+            i = out[v];
+            addChild(red, s, node[i]);
+            if(red->capacity[node[i]] < capacity)
+                capacity = red->capacity[node[i]];
+        }
+        red->capacity[s] = capacity;
+        /* A chain back to its own start carries no flow to the sink. */
+        if(v != tail[e])
+            keepEdge(red, tail[e], v, s);
+    }
+#undef INNER
+    free(tail);
+}
+
+/* Hands the flow of every standing edge down its tree onto g's edges,
+   filling parallel edges in turn. */
+static void distributeFlows(FlowGraph g, struct Reduction *red, const double *flows)
+{
+    int *stack = (int *) malloc((red->numNodes ? red->numNodes : 1) * sizeof(int));
+    double *amount = (double *) malloc((red->numNodes ? red->numNodes : 1) *
+                                       sizeof(double));
+    int top = 0, i, u, c;
+    double flow, part;
+
+    for(i = 0; i < g->numEdges; i++)
+        g->flow[i] = 0.0;
+    for(i = 0; i < red->count; i++) {
+        stack[top] = red->node[i];
+        amount[top++] = flows[i];
+    }
+    while(top > 0) {
+        u = stack[--top];
+        flow = amount[top];
+        if(red->kind[u] == TREE_EDGE) {
+            g->flow[u] = flow;
+            continue;
         }
-        /* Now increment the flow. */
-        v = g->sink;
-        while(v != g->source) {
-            addFlow(&mfi, v->predEdge, increment);
-            v = v->predEdge->from;
+        if(red->kind[u] == TREE_TERMINAL)
+            continue;
+        for(c = red->child[u]; c >= 0; c = red->sibling[c]) {
+            part = flow;
+            if(red->kind[u] == TREE_PARALLEL) {
+                part = MIN(red->capacity[c], flow);
+                flow -= part;
+            }
+            stack[top] = c;
+            amount[top++] = part;
+        }
+    }
+    free(stack);
+    free(amount);
+}
+
+static double solve(FlowGraph g, double (*solver)(FlowGraph));
+static long edgeBytes(FlowGraph g);
+
+/* Solves g through the smaller graph, from zero flow, and leaves the
+   flows on g's edges. */
+static double solveReduced(FlowGraph g, double (*solver)(FlowGraph))
+{
+    struct Reduction red;
+    FlowGraph h;
+    double start = now(), maxflowVal, *flows, *total, rest;
+    int *id, *from, *to, i, v, k, n = Graph_numVertices(g), m = g->numEdges,
+        size = m, numVertices = 2;
+
+    /* Join the virtual terminals to the terminal sets as freeze() does. */
+    restoreEdges(g);
+    total = (double *) malloc((g->numTerminals + 1) * sizeof(double));
+    size += terminalTotals(g, total);
+    red.source = SOURCE_ID;
+    red.sink = SINK_ID;
+    red.capMax = g->engine->capMax;
+    if(g->numTerminals) {
+        red.source = n;
+        red.sink = n + 1;
+        n += 2;
+    }
+    red.numVertices = n;
+    red.kind = (int *) malloc((2 * size + 1) * sizeof(int));
+    red.capacity = (double *) malloc((2 * size + 1) * sizeof(double));
+    red.child = (int *) malloc((2 * size + 1) * sizeof(int));
+    red.sibling = (int *) malloc((2 * size + 1) * sizeof(int));
+    red.tail = (int *) malloc((size + 1) * sizeof(int));
+    red.head = (int *) malloc((size + 1) * sizeof(int));
+    red.node = (int *) malloc((size + 1) * sizeof(int));
+    red.order = (int *) malloc((2 * n + 1) * sizeof(int));
+    red.numNodes = 0;
+    red.count = 0;
+    for(i = 0; i < m; i++) {
+        newNode(&red, TREE_EDGE, solverCapacity(g, g->capacity[i]));
+        /* Edges into the source or out of the sink, self edges and
+           edges without capacity carry nothing to the sink. */
+        if(red.capacity[i] > 0 && g->from[i] != g->to[i] && g->to[i] != red.source &&
+           g->from[i] != red.sink)
+            keepEdge(&red, g->from[i], g->to[i], i);
+    }
+    for(k = 0; k < g->numTerminals; k++) {
+        for(rest = total[k]; rest > 0; rest -= g->engine->capMax) {
+            i = newNode(&red, TREE_TERMINAL, MIN(rest, g->engine->capMax));
+            if(k < g->numSources)
+                keepEdge(&red, red.source, g->terminals[k], i);
+            else
+                keepEdge(&red, g->terminals[k], red.sink, i);
         }
-        maxflowVal += increment;
     }
+    free(total);
+    pruneDead(&red);
+    mergeParallel(&red);
+    contractSeries(&red);
+    mergeParallel(&red);
+
+    /* Number the vertices left, keeping the terminals in place. */
+    id = red.order;
+    for(v = 0; v < n; v++)
+        id[v] = -1;
+    id[red.source] = SOURCE_ID;
+    id[red.sink] = SINK_ID;
+    from = (int *) malloc((2 * red.count + 1) * sizeof(int));
+    to = from + red.count;
+    for(i = 0; i < red.count; i++) {
+        if(id[red.tail[i]] < 0)
+            id[red.tail[i]] = numVertices++;
+        if(id[red.head[i]] < 0)
+            id[red.head[i]] = numVertices++;
+        from[i] = id[red.tail[i]];
+        to[i] = id[red.head[i]];
+    }
+    flows = (double *) malloc((red.count + 1) * sizeof(double));
+    for(i = 0; i < red.count; i++)
+        flows[i] = red.capacity[red.node[i]];
 
-    free(mfi.visited);
-    free(mfi.queue);
-    for(i = 0; i < mfi.numReverseEdges; i++) {
-        e = mfi.reverseEdges[i];
-        e->reverseEdge->reverseEdge = NULL;
-        e->from->degree--;
-        free(e);
+    h = Graph_newTyped(numVertices, red.count, g->type);
+    Graph_addEdges(h, from, to, flows, red.count);
+    h->threads = g->threads;
+    h->ordering = g->ordering;
+    /* What is left of the deadline, which must stay a deadline. */
+    h->limits.seconds = g->limits.seconds;
+    if(h->limits.seconds > 0) {
+        h->limits.seconds -= now() - start;
+        if(h->limits.seconds <= 0)
+            h->limits.seconds = 1e-9;
     }
-    free(mfi.reverseEdges);
+    h->limits.iterations = g->limits.iterations;
+    h->limits.cancel = g->limits.cancel;
+    maxflowVal = solve(h, solver);
+    Graph_getFlows(h, flows, CAP_DOUBLE);
+
+    releaseResidual(g);
+    distributeFlows(g, &red, flows);
+    g->stats = h->stats;
+    g->stats.buildSeconds = now() - start - h->stats.solveSeconds;
+    g->stats.reducedVertices = numVertices;
+    g->stats.reducedEdges = red.count;
+    g->stats.edgeBytes = edgeBytes(g);
+
+    Graph_free(h);
+    free(from);
+    free(flows);
+    free(red.kind);
+    free(red.capacity);
+    free(red.child);
+    free(red.sibling);
+    free(red.tail);
+    free(red.head);
+    free(red.node);
+    free(red.order);
+    return maxflowVal;
+}
+
+/* --------------------------------------------------------------------------- */
+
+/* The memory the edges take outside the residual graph, for the stats;
+   the lookup table's own nodes are left out. */
+static long edgeBytes(FlowGraph g)
+{
+    long bytes = 0;
+    if(g->from)
+        bytes += (long) g->edgeSlots * (2 * sizeof(int) + 2 * sizeof(double));
+    if(g->parallel)
+        bytes += (long) g->edgeSlots * sizeof(int);
+    if(g->cost)
+        bytes += (long) g->edgeSlots * sizeof(double);
+    return bytes;
+}
+
+/* Runs one of the engine's solvers, timing the residual graph build
+   apart from the solve itself. */
+static double solve(FlowGraph g, double (*solver)(FlowGraph))
+{
+    struct SolveStats *s = &g->stats;
+    struct Residual *r;
+    double start = now(), built, maxflowVal;
+    int building = !g->residual;
+
+    /* Merging parallel edges would lose their costs. */
+    if(g->reduce && solver != g->engine->maxflowMinCost)
+        return solveReduced(g, solver);
+    memset(s, 0, sizeof(*s));
+    g->limits.deadline = start + g->limits.seconds;
+    g->limits.stopped = 0;
+    r = residualOf(g);
+    built = now();
+    g->limits.active = 1;
+    maxflowVal = solver(g);
+    g->limits.active = 0;
+    s->optimal = !g->limits.stopped;
+    g->limits.stopped = 0;
+    s->buildSeconds = built - start;
+    s->solveSeconds = now() - built;
+    s->arcs = r->numArcs;
+    s->reverseArcs = building ? g->numEdges : 0;
+    s->peakBytes = (long) r->numArcs * (2 * sizeof(int) + g->engine->capSize) +
+                   (long) (r->numArcs / 2) * sizeof(int) +
+                   (long) (r->numVertices + 1) * sizeof(int) +
+                   (long) r->numVertices * (SCRATCH_INTS * sizeof(int) + g->engine->sumSize) +
+                   3 * (long) r->seen.words * (sizeof(uint64_t) + sizeof(unsigned));
+    if(r->arcCost)
+        s->peakBytes += (long) r->numArcs * sizeof(double) +
+                        2 * (long) r->numVertices * sizeof(double);
+    dropEdges(g);
+    s->edgeBytes = edgeBytes(g);
     return maxflowVal;
 }
 
+double Graph_maxflow(FlowGraph g)
+{
+    return solve(g, g->engine->maxflow);
+}
+
+double Graph_maxflowBidirectional(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowBidirectional);
+}
+
+double Graph_maxflowScaling(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowScaling);
+}
+
+double Graph_maxflowPushRelabel(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowPushRelabel);
+}
+
+double Graph_maxflowParallel(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowParallel);
+}
+
+double Graph_maxflowDinic(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowDinic);
+}
+
+double Graph_maxflowMinCost(FlowGraph g)
+{
+    return solve(g, g->engine->maxflowMinCost);
+}
+
+void Graph_setThreads(FlowGraph g, int threads)
+{
+    g->threads = threads;
+}
+
+int Graph_setCapacity(FlowGraph g, int from, int to, double capacity)
+{
+    int i = findEdge(g, from, to);
+    if(i < 0)
+        return 0;
+    return Graph_setEdgeCapacity(g, i, capacity);
+}
+
+int Graph_setEdgeCapacity(FlowGraph g, int index, double capacity)
+{
+    struct Residual *r = g->residual;
+    double old;
+    int a, k, v;
+    if(index < 0 || index >= g->numEdges)
+        return 0;
+    capacity = fitCapacity(g, capacity);
+    if(r && r->numTerminals) {
+        /* Rebuild the terminal arcs once one at an end of the edge could
+           be too small. */
+        a = r->edgeArc[index];
+        old = g->capacity ? g->capacity[index] :
+              g->engine->arcValue(r, a) + g->engine->arcValue(r, r->rev[a]);
+        for(k = 0; r->head[a] != r->head[r->rev[a]] && k < r->numTerminals; k++) {
+            v = residualId(r, g->terminals[k]);
+            if(v != r->head[a] && v != r->head[r->rev[a]])
+                continue;
+            r->terminalTotal[k] += MAX(capacity, 0) - MAX(old, 0);
+            if(r->terminalTotal[k] > r->terminalSized[k]) {
+                releaseResidual(g);
+                break;
+            }
+        }
+    }
+    if(g->capacity)
+        g->capacity[index] = capacity;
+    g->engine->setCapacity(g, index, capacity);
+    return 1;
+}
+
+/* Costs are only stored once one is set, and the residual graph needs
+   arc costs from then on. */
+static void allocateCosts(FlowGraph g)
+{
+    if(g->cost)
+        return;
+    g->cost = (double *) calloc(g->edgeSlots, sizeof(double));
+    releaseResidual(g);
+}
+
+int Graph_setEdgeCosts(FlowGraph g, int first, const double *cost, int count)
+{
+    struct Residual *r;
+    int i, a;
+    if(first < 0 || count < 0 || first > g->numEdges - count)
+        return 0;
+    if(count == 0)
+        return 1;
+    allocateCosts(g);
+    r = g->residual;
+    for(i = first; i < first + count; i++) {
+        g->cost[i] = cost[i - first];
+        if(r) {
+            a = r->edgeArc[i];
+            r->arcCost[a] = g->cost[i];
+            r->arcCost[r->rev[a]] = -g->cost[i];
+        }
+    }
+    return 1;
+}
+
+int Graph_setEdgeCost(FlowGraph g, int index, double cost)
+{
+    return Graph_setEdgeCosts(g, index, &cost, 1);
+}
+
+double Graph_getEdgeCost(FlowGraph g, int index)
+{
+    if(!g->cost || index < 0 || index >= g->numEdges)
+        return 0.0;
+    return g->cost[index];
+}
+
+double Graph_flowCost(FlowGraph g)
+{
+    double total = 0;
+    int i;
+    for(i = 0; g->cost && i < g->numEdges; i++)
+        if(g->cost[i] != 0)
+            total += g->cost[i] * Graph_getEdgeFlow(g, i);
+    return total;
+}
+
+const struct SolveStats *Graph_stats(FlowGraph g)
+{
+    return &g->stats;
+}
+
+void Graph_setOrdering(FlowGraph g, VertexOrder ordering)
+{
+    if(ordering != g->ordering)
+        releaseResidual(g);
+    g->ordering = ordering;
+}
+
+void Graph_setReduction(FlowGraph g, int reduce)
+{
+    g->reduce = reduce;
+}
+
+void Graph_setCompact(FlowGraph g, int compact)
+{
+    g->compact = compact;
+    if(compact)
+        dropEdges(g);
+    else if(g->residual)
+        restoreEdges(g);
+}
+
+void Graph_setLimits(FlowGraph g, double seconds, long iterations,
+                     const volatile int *cancel)
+{
+    g->limits.seconds = seconds;
+    g->limits.iterations = iterations;
+    g->limits.cancel = cancel;
+}
+
 void Graph_resetFlows(FlowGraph g)
 {
-    struct Edge *e;
-    TableFixedIter_T iter = TableFixedIter_new(g->edges);
-    TableFixedIter_selectFirst(iter);
-    while(TableFixedIter_valid(iter)) {
-        e = (struct Edge *) TableFixedIter_selectedValue(iter);
-        e->flow = 0.0;
-        TableFixedIter_selectNext(iter);
+    g->engine->resetFlows(g);
+}
+
+int Graph_minCut(FlowGraph g, int *vertices)
+{
+    struct Residual *r;
+    int n = Graph_numVertices(g), v, u, count = 0;
+    g->engine->findCut(g);
+    r = g->residual;
+    for(v = 0; v < n; v++) {
+        u = internalId(g, v);
+        if(u < r->numIds && setHas(&r->seen, residualId(r, u)))
+            vertices[count++] = v;
     }
-    TableFixedIter_free(iter);
+    return count;
 }
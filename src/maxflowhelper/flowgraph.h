@@ -1,13 +1,161 @@
 #ifndef FLOWGRAPH_INCLUDED
 #define FLOWGRAPH_INCLUDED
 
+#include <limits.h>
+#include <stdint.h>
+
 typedef struct Graph *FlowGraph;
 
+/* The most edges to make room for up front when the count comes from
+   a caller or a file that may not mean it. */
+#define GRAPH_MAX_HINT (1 << 20)
+
+/* The most edges a graph holds.  Arcs are numbered with ints, two for
+   every edge, which leaves room for as many terminal arcs again. */
+#define GRAPH_MAX_EDGES (INT_MAX / 4)
+
+/* The type the residual capacities are stored and solved in.  Values
+   cross the interface as doubles either way; integer capacities are
+   truncated, and their flows are exact. */
+typedef enum {
+    CAP_FLOAT,
+    CAP_DOUBLE,
+    CAP_INT32,
+    CAP_INT64
+} CapacityType;
+
+/* How the vertices of the residual graph are numbered. */
+typedef enum {
+    ORDER_NONE,             /* As the caller numbered them */
+    ORDER_BFS,              /* Breadth-first from the source */
+    ORDER_RCM               /* Reverse Cuthill-McKee */
+} VertexOrder;
+
+/* What the last solve did.  The counts are of the work the solver
+   did, so they differ between solvers for the same graph; those a
+   solver has no use for stay 0. */
+struct SolveStats {
+    long augmentations;     /* Augmenting paths, or Dinic paths */
+    long verticesScanned;   /* Vertices reached by breadth-first searches */
+    long arcsScanned;       /* Arcs examined by those searches */
+    long pushes;
+    long relabels;
+    long globalRelabels;
+    long gaps;
+    long phases;            /* Scaling, Dinic or push-relabel phases */
+    long iterations;        /* Path searches or discharges */
+    int optimal;            /* 0 if a limit stopped the solve early */
+    long arcs;              /* Arcs in the residual graph */
+    long reverseArcs;       /* Reverse arcs created for this solve */
+    long peakBytes;         /* Memory held by the residual graph */
+    long edgeBytes;         /* Held by the edges outside it, after the solve */
+    long reducedVertices;   /* Left by the reduction pass, if it ran */
+    long reducedEdges;
+    double buildSeconds;    /* Building the residual graph */
+    double solveSeconds;    /* Solving on it */
+};
+
+/* numEdges is how many edges to make room for; the edge arrays grow
+   past it as needed.  Returns NULL if they cannot be allocated. */
 FlowGraph Graph_new(int numVertices, int numEdges);
+FlowGraph Graph_newTyped(int numVertices, int numEdges, CapacityType type);
 void Graph_free(FlowGraph g);
-void Graph_addEdge(FlowGraph g, int from, int to, float capacity);
-float Graph_maxflow(FlowGraph g);
-float Graph_getFlow(FlowGraph g, int from, int to);
+/* Makes source and sink, rather than 0 and 1, the terminals of a graph
+   without edges yet.  Returns 0 if that is not possible. */
+int Graph_setTerminals(FlowGraph g, int source, int sink);
+void Graph_getTerminals(FlowGraph g, int *source, int *sink);
+/* Makes the solves that follow run from the vertices in sources to
+   those in sinks, through a virtual source and sink joined to them by
+   arcs that are never the bottleneck (unless the capacities at a
+   terminal add up past the largest of the capacity type), without
+   rebuilding the graph.  Empty sets return to the graph's own
+   terminals.  Flows start again from zero whenever the terminals
+   change.  Returns 0 if a vertex id is out of range or named twice. */
+int Graph_setSolveTerminals(FlowGraph g, const int *sources, int numSources,
+                            const int *sinks, int numSinks);
+/* The functions adding edges return 0, adding none, if the graph would
+   pass GRAPH_MAX_EDGES edges or its edge arrays cannot grow. */
+int Graph_addEdge(FlowGraph g, int from, int to, double capacity);
+int Graph_addEdges(FlowGraph g, const int *from, const int *to,
+                   const double *capacity, int count);
+/* Adds the edges of a graph in compressed sparse row form: the edges
+   out of vertex v run to heads[first[v]] .. heads[first[v+1]-1], with
+   their capacities at the same positions of an array of the given
+   type.  They are numbered in that order. */
+int Graph_addEdgesCSR(FlowGraph g, int numTails, const int64_t *first,
+                      const int *heads, const void *capacity, CapacityType type);
+/* Writes the tail, head and capacity of every edge, in insertion
+   order, to whichever of the arrays is not NULL. */
+void Graph_getEdges(FlowGraph g, int *from, int *to, double *capacity);
+int Graph_numEdges(FlowGraph g);
+int Graph_numVertices(FlowGraph g);
+CapacityType Graph_capacityType(FlowGraph g);
+/* Returns 1 if capacity is in the range of the graph's capacity type.
+   Edges are added and changed with capacities outside it clamped to
+   it. */
+int Graph_capacityFits(FlowGraph g, double capacity);
+/* The same for a capacity type, before there is a graph of it. */
+int Graph_capacityFitsType(CapacityType type, double capacity);
+double Graph_maxflow(FlowGraph g);
+double Graph_maxflowBidirectional(FlowGraph g);
+double Graph_maxflowScaling(FlowGraph g);
+double Graph_maxflowPushRelabel(FlowGraph g);
+double Graph_maxflowDinic(FlowGraph g);
+double Graph_maxflowParallel(FlowGraph g);
+/* A max flow of the least total cost, by successive shortest paths.
+   Costs may be negative as long as capacities bound every cycle that
+   they make negative; such cycles are cancelled first.  It continues
+   from the current flow, like the other solvers, and the flow after a
+   bounded solve stops is the cheapest of its value. */
+double Graph_maxflowMinCost(FlowGraph g);
+void Graph_setThreads(FlowGraph g, int threads);
+/* With reduce nonzero, solves drop the edges that no flow can use,
+   merge parallel edges and contract chains of single-in, single-out
+   vertices, solve the smaller graph, and map its flows back onto the
+   edges.  They start from zero flow, and their stats are those of the
+   smaller graph with the reduction counted in buildSeconds. */
+void Graph_setReduction(FlowGraph g, int reduce);
+/* With compact nonzero, a solved graph keeps its edges in nothing but
+   the arcs of the residual graph, 14 bytes an arc with 32-bit
+   capacities, and frees the 24 bytes an edge of its own arrays.  They
+   are put back from the arcs when something needs them: adding edges,
+   listing them, the first lookup by their ends, changing the ordering
+   or the terminals, or a reduced solve.  Capacities put back
+   are those of the graph's capacity type. */
+void Graph_setCompact(FlowGraph g, int compact);
+/* Renumbers the vertices of the residual graph the solvers work on, so
+   that neighbours sit close together in memory.  Vertex ids at this
+   interface stay as they are. */
+void Graph_setOrdering(FlowGraph g, VertexOrder ordering);
+const struct SolveStats *Graph_stats(FlowGraph g);
+/* Bounds the solves that follow by seconds of wall clock time, by
+   iterations (path searches, or vertex discharges for push-relabel),
+   and by *cancel becoming nonzero, which another thread may do at any
+   time; 0 or NULL leaves a bound out.  A solve that reaches a bound
+   stops with the best flow so far, which is feasible but may not be
+   maximum, and clears optimal in its stats. */
+void Graph_setLimits(FlowGraph g, double seconds, long iterations,
+                     const volatile int *cancel);
+/* Edges are numbered in the order they were added.  Lookups by their
+   ends cover all parallel edges for flows and the first one added for
+   capacity changes. */
+double Graph_getFlow(FlowGraph g, int from, int to);
+double Graph_getEdgeFlow(FlowGraph g, int index);
+void Graph_getFlows(FlowGraph g, void *flows, CapacityType type);
+int Graph_setCapacity(FlowGraph g, int from, int to, double capacity);
+int Graph_setEdgeCapacity(FlowGraph g, int index, double capacity);
+/* Edges cost nothing per unit of flow until given a cost.  The costs of
+   the count edges from index first on are set from cost; both return 0
+   if there is no such edge. */
+int Graph_setEdgeCost(FlowGraph g, int index, double cost);
+int Graph_setEdgeCosts(FlowGraph g, int first, const double *cost, int count);
+double Graph_getEdgeCost(FlowGraph g, int index);
+/* The total cost of the current flow. */
+double Graph_flowCost(FlowGraph g);
 void Graph_resetFlows(FlowGraph g);
+/* Writes the ids of the vertices on the source side of a minimum cut
+   for the current flow, in increasing order, and returns how many
+   there are.  vertices needs room for Graph_numVertices() ids. */
+int Graph_minCut(FlowGraph g, int *vertices);
 
 #endif /* FLOWGRAPH_INCLUDED */
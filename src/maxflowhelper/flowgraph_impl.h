@@ -0,0 +1,1463 @@
+/* The solvers, instantiated once for each capacity type by
+   flowgraph.c.  The includer defines CAP as the type of the residual
+   capacities, SUM as the type excesses and flow values are summed in,
+   CAP_MAX and SUM_MAX as their largest values, CAP_LIMIT as the
+   largest double that converts to CAP, and SUFFIX as the name pasted
+   onto every function defined here.  All of them are undefined
+   again at the end. */
+
+#define T(name) PASTE(name, SUFFIX)
+#define RESIDUAL(r) ((CAP *) (r)->residual)
+
+/* --------------------------------------------------------------------------- */
+/* Moving flows between the edges and the arcs. */
+
+/* Fills in the residual capacities of a freshly built residual graph
+   from the capacities and current flows of the edges. */
+static void T(loadArcs)(FlowGraph g, struct Residual *r)
+{
+    SUM *net = (SUM *) r->excess, flow;
+    int i, a, j, k, v;
+    for(i = 0; i < g->numEdges; i++) {
+        a = r->edgeArc[i];
+        RESIDUAL(r)[a] = (CAP) g->capacity[i] - (CAP) g->flow[i];
+        RESIDUAL(r)[r->rev[a]] = (CAP) g->flow[i];
+    }
+    if(!r->numTerminals)
+        return;
+
+    /* The arcs of a terminal carry what its vertex sends out or takes
+       in, filling all but its last arc up to capacity first. */
+    memset(net, 0, r->numVertices * sizeof(SUM));
+    for(i = 0; i < g->numEdges; i++) {
+        net[residualId(r, g->from[i])] -= (CAP) g->flow[i];
+        net[residualId(r, g->to[i])] += (CAP) g->flow[i];
+    }
+    for(j = 0; j < r->numTerminalArcs; j++) {
+        k = r->terminalOf[j];
+        a = r->edgeArc[g->numEdges + j];
+        v = k < r->numSources ? r->head[a] : r->head[r->rev[a]];
+        flow = k < r->numSources ? -net[v] : net[v];
+        if(j + 1 < r->numTerminalArcs && r->terminalOf[j + 1] == k)
+            flow = MIN(flow, (SUM) r->terminalCapacity[j]);
+        net[v] += k < r->numSources ? flow : -flow;
+        RESIDUAL(r)[r->rev[a]] = (CAP) flow;
+        RESIDUAL(r)[a] = (CAP) r->terminalCapacity[j] - RESIDUAL(r)[r->rev[a]];
+    }
+}
+
+/* Copies the flows from the reverse arcs back onto the edges. */
+static void T(storeFlows)(FlowGraph g, struct Residual *r)
+{
+    int i;
+    for(i = 0; i < g->numEdges; i++)
+        g->flow[i] = RESIDUAL(r)[r->rev[r->edgeArc[i]]];
+}
+
+/* Recovers the capacities of the edges from their arcs. */
+static void T(storeCapacities)(FlowGraph g, struct Residual *r)
+{
+    int i, a;
+    for(i = 0; i < g->numEdges; i++) {
+        a = r->edgeArc[i];
+        g->capacity[i] = (CAP) (RESIDUAL(r)[a] + RESIDUAL(r)[r->rev[a]]);
+    }
+}
+
+static double T(arcValue)(struct Residual *r, int arc)
+{
+    return RESIDUAL(r)[arc];
+}
+
+/* Writes the edge flows to flows, an array of the given type. */
+static void T(getFlows)(FlowGraph g, void *flows, CapacityType type)
+{
+    struct Residual *r = g->residual;
+    CAP flow;
+    int i;
+    for(i = 0; i < g->numEdges; i++) {
+        flow = r ? RESIDUAL(r)[r->rev[r->edgeArc[i]]] : (CAP) g->flow[i];
+        switch(type) {
+        case CAP_FLOAT:  ((float *) flows)[i] = flow;   break;
+        case CAP_DOUBLE: ((double *) flows)[i] = flow;  break;
+        case CAP_INT32:  ((int32_t *) flows)[i] = flow; break;
+        case CAP_INT64:  ((int64_t *) flows)[i] = flow; break;
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+/* Returns the net flow into the sink, which every solver starts from
+   so that a solve can continue from the flow left by the last one. */
+static SUM T(flowValue)(FlowGraph g, struct Residual *r)
+{
+    SUM value = 0;
+    int i, a;
+    if(r->numTerminals) {
+        for(i = 0; i < r->numTerminalArcs; i++)
+            if(r->terminalOf[i] >= r->numSources)
+                value += RESIDUAL(r)[r->rev[r->edgeArc[g->numEdges + i]]];
+        return value;
+    }
+    /* Ordering keeps the sink at SINK_ID. */
+    for(i = 0; i < g->numEdges; i++) {
+        a = r->edgeArc[i];
+        if(r->head[a] == SINK_ID)
+            value += RESIDUAL(r)[r->rev[a]];
+        if(r->head[r->rev[a]] == SINK_ID)
+            value -= RESIDUAL(r)[r->rev[a]];
+    }
+    return value;
+}
+
+static inline void T(addFlow)(struct Residual *r, int arc, CAP amount)
+{
+    RESIDUAL(r)[arc] -= amount;
+    RESIDUAL(r)[r->rev[arc]] += amount;
+}
+
+/* Returns a mask of which of the count arcs from a on, at most
+   SCAN_WIDTH of them, have a residual capacity of at least min, and
+   positive; bit k stands for arc a + k.  With reverse, it is their
+   reverse arcs that must have the capacity. */
+static inline uint64_t T(scanArcs)(struct Residual *r, int a, int count, int reverse, CAP min)
+{
+    const CAP *residual = RESIDUAL(r);
+    uint64_t mask = 0;
+    CAP x;
+    int k;
+    if(count >= SCAN_DEGREE)
+        return r->scan->T(scan)(reverse ? residual : residual + a,
+                                reverse ? r->rev + a : NULL, count, min);
+    for(k = 0; k < count; k++) {
+        x = residual[reverse ? r->rev[a + k] : a + k];
+        mask |= (uint64_t) (x > 0 && x >= min) << k;
+    }
+    return mask;
+}
+
+/* --------------------------------------------------------------------------- */
+/* maxflow algorithm here is an adaptation of the Ford-Fulkerson
+   algorithm as presented in
+   http://www.aduni.org/courses/algorithms/courseware/handouts/Reciation_09.html. */
+
+/* The augmenting path search is a level-synchronous BFS that switches
+   between expanding the frontier top-down and, once the frontier
+   covers a large part of the remaining arcs, checking the unvisited
+   vertices bottom-up for a parent in the frontier (Beamer et al.,
+   "Direction-Optimizing Breadth-First Search").  It can also grow a
+   second search back from the sink, always expanding the smaller
+   side, and stop where the two meet.  The visited sets are emptied in
+   constant time, so a short path costs only what it explores. */
+
+
+struct T(MaxFlowInfo) {
+    struct Residual *r;
+    int bidirectional;
+    /* Levels of the search from the source: queue[head..tail) is the
+       current frontier, and each level is added behind it. */
+    int *queue;
+    int head;
+    int tail;
+    int *predArc;              /* Arc by which each vertex was reached */
+    /* Same for the search back from the sink. */
+    int *backQueue;
+    int backHead;
+    int backTail;
+    int *succArc;              /* Arc by which each vertex reaches the sink */
+    long scanned;              /* Arcs looked at by the last bottom-up step */
+    CAP threshold;             /* Residual an arc needs to be used, if above 0 */
+};
+
+
+/* Adds v to the forward search by arc a and returns whether it ends
+   the search. */
+static inline int T(visit)(struct T(MaxFlowInfo) *mfi, int v, int a, int sink)
+{
+    struct Residual *r = mfi->r;
+    setAdd(&r->seen, v);
+    mfi->predArc[v] = a;
+    mfi->queue[mfi->tail++] = v;
+    return v == sink || (mfi->bidirectional && setHas(&r->backSeen, v));
+}
+
+static int T(expandTopDown)(struct T(MaxFlowInfo) *mfi, int sink)
+{
+    struct Residual *r = mfi->r;
+    int i, end = mfi->tail, u, v, a, b, last;
+    uint64_t usable;
+
+    for(i = mfi->head; i < end; i++) {
+        u = mfi->queue[i];
+        for(a = r->first[u], last = r->first[u + 1]; a < last; a += SCAN_WIDTH) {
+            usable = T(scanArcs)(r, a, MIN(last - a, SCAN_WIDTH), 0, mfi->threshold);
+            for(; usable; usable &= usable - 1) {
+                b = a + __builtin_ctzll(usable);
+                v = r->head[b];
+                if(!setHas(&r->seen, v) && T(visit)(mfi, v, b, sink))
+                    return v;
+            }
+        }
+    }
+    mfi->head = end;
+    return -1;
+}
+
+static int T(expandBottomUp)(struct T(MaxFlowInfo) *mfi, int sink)
+{
+    struct Residual *r = mfi->r;
+    int i, end = mfi->tail, w, v, a, b, last;
+    uint64_t unseen, usable;
+
+    setClear(&r->frontier);
+    for(i = mfi->head; i < end; i++)
+        setAdd(&r->frontier, mfi->queue[i]);
+    mfi->scanned = 0;
+    for(w = 0; w < r->seen.words; w++) {
+        unseen = ~setWord(&r->seen, w);
+        while(unseen) {
+            v = 64 * w + __builtin_ctzll(unseen);
+            unseen &= unseen - 1;
+            if(v >= r->numVertices)
+                break;
+            /* rev[a] is the residual arc into v. */
+            for(a = r->first[v], last = r->first[v + 1], b = -1; b < 0 && a < last;
+                a += SCAN_WIDTH) {
+                usable = T(scanArcs)(r, a, MIN(last - a, SCAN_WIDTH), 1, mfi->threshold);
+                for(; usable; usable &= usable - 1) {
+                    b = a + __builtin_ctzll(usable);
+                    if(setHas(&r->frontier, r->head[b]))
+                        break;
+                    b = -1;
+                }
+            }
+            mfi->scanned += (b < 0 ? last : b + 1) - r->first[v];
+            if(b >= 0 && T(visit)(mfi, v, r->rev[b], sink))
+                return v;
+        }
+    }
+    mfi->head = end;
+    return -1;
+}
+
+/* One level of the search back from the sink; returns the vertex where
+   it meets the forward search, if it does. */
+static int T(expandBackward)(struct T(MaxFlowInfo) *mfi)
+{
+    struct Residual *r = mfi->r;
+    int i, end = mfi->backTail, u, v, a, b, last;
+    uint64_t usable;
+
+    for(i = mfi->backHead; i < end; i++) {
+        v = mfi->backQueue[i];
+        for(a = r->first[v], last = r->first[v + 1]; a < last; a += SCAN_WIDTH) {
+            usable = T(scanArcs)(r, a, MIN(last - a, SCAN_WIDTH), 1, mfi->threshold);
+            for(; usable; usable &= usable - 1) {
+                b = a + __builtin_ctzll(usable);
+                u = r->head[b];
+                if(!setHas(&r->backSeen, u)) {
+                    setAdd(&r->backSeen, u);
+                    mfi->succArc[u] = r->rev[b];
+                    mfi->backQueue[mfi->backTail++] = u;
+                    if(setHas(&r->seen, u))
+                        return u;
+                }
+            }
+        }
+    }
+    mfi->backHead = end;
+    return -1;
+}
+
+/* Finds an augmenting path and leaves it in predArc, from the sink
+   back to the source.  Returns 0 if there is none. */
+static int T(findPath)(struct T(MaxFlowInfo) *mfi, int source, int sink)
+{
+    struct Residual *r = mfi->r;
+    struct SolveStats *stats = r->stats;
+    int meet = -1, bottomUp = 0, allowBottomUp = 1, lastSize = 0, i, v, a;
+    long frontierArcs, unexploredArcs = r->numArcs;
+
+    setClear(&r->seen);
+    mfi->head = mfi->tail = 0;
+    T(visit)(mfi, source, -1, -1);
+    frontierArcs = degree(r, source);
+    if(mfi->bidirectional) {
+        setClear(&r->backSeen);
+        setAdd(&r->backSeen, sink);
+        mfi->backHead = mfi->backTail = 0;
+        mfi->backQueue[mfi->backTail++] = sink;
+    }
+
+    while(meet < 0) {
+        if(mfi->bidirectional && mfi->backTail - mfi->backHead < mfi->tail - mfi->head) {
+            i = mfi->backHead;
+            for(v = mfi->backHead; v < mfi->backTail; v++)
+                stats->arcsScanned += degree(r, mfi->backQueue[v]);
+            meet = T(expandBackward)(mfi);
+            stats->verticesScanned += mfi->backTail - i;
+            if(meet < 0 && mfi->backHead == mfi->backTail)
+                return 0;
+            continue;
+        }
+        if(mfi->head == mfi->tail)
+            return 0;
+        unexploredArcs -= frontierArcs;
+        if(!bottomUp && allowBottomUp && mfi->tail - mfi->head > lastSize &&
+           frontierArcs > unexploredArcs / BOTTOM_UP_ALPHA)
+            bottomUp = 1;
+        else if(bottomUp && mfi->tail - mfi->head < r->numVertices / BOTTOM_UP_BETA)
+            bottomUp = 0;
+        lastSize = mfi->tail - mfi->head;
+        i = mfi->tail;
+        if(bottomUp) {
+            meet = T(expandBottomUp)(mfi, sink);
+            /* Saturated arcs can make unreachable vertices expensive to
+               check; give up on bottom-up steps for this search once one
+               costs more than expanding the frontier would have. */
+            stats->arcsScanned += mfi->scanned;
+            if(mfi->scanned > frontierArcs)
+                bottomUp = allowBottomUp = 0;
+        } else {
+            meet = T(expandTopDown)(mfi, sink);
+            stats->arcsScanned += frontierArcs;
+        }
+        stats->verticesScanned += mfi->tail - i;
+        for(frontierArcs = 0; i < mfi->tail; i++)
+            frontierArcs += degree(r, mfi->queue[i]);
+    }
+
+    /* Extend the path from the meeting point to the sink. */
+    for(v = meet; v != sink; v = r->head[a]) {
+        a = mfi->succArc[v];
+        mfi->predArc[r->head[a]] = a;
+    }
+    return 1;
+}
+
+static void T(initMaxFlowInfo)(struct Residual *r, struct T(MaxFlowInfo) *mfi,
+                            int bidirectional)
+{
+    int n = r->numVertices;
+    mfi->r = r;
+    mfi->bidirectional = bidirectional;
+    mfi->threshold = 0;
+    mfi->predArc = r->scratch;
+    mfi->succArc = r->scratch + n;
+    mfi->queue = r->scratch + 2 * n;
+    mfi->backQueue = r->scratch + 3 * n;
+}
+
+/* Sends up to limit units of flow from source to sink along shortest
+   augmenting paths and returns the amount sent. */
+static SUM T(augment)(struct Residual *r, struct T(MaxFlowInfo) *mfi,
+                      int source, int sink, SUM limit)
+{
+    int v, a;
+    SUM increment, total = 0;
+
+    /* While there exists an augmenting path, increment the flow along
+       this path. */
+    while(total < limit && !limitReached(r, 1) && T(findPath)(mfi, source, sink)) {
+        /* Determine the amount by which we can increment the flow. */
+        increment = limit - total;
+        v = sink;
+        while(v != source) {
+            a = mfi->predArc[v];
+            increment = MIN(increment, RESIDUAL(r)[a]);
+            v = r->head[r->rev[a]];
+        }
+        /* Now increment the flow. */
+        r->stats->augmentations++;
+        v = sink;
+        while(v != source) {
+            a = mfi->predArc[v];
+            T(addFlow)(r, a, (CAP) increment);
+            v = r->head[r->rev[a]];
+        }
+        total += increment;
+    }
+    return total;
+}
+
+static double T(maxflow)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    struct T(MaxFlowInfo) mfi;
+    SUM maxflowVal = T(flowValue)(g, r);
+
+    T(initMaxFlowInfo)(r, &mfi, 0);
+    maxflowVal += T(augment)(r, &mfi, SOURCE_ID, SINK_ID, SUM_MAX);
+    /* The search that found no path reached the source side of a
+       minimum cut. */
+    r->cutKnown = !r->limits->stopped;
+    return maxflowVal;
+}
+
+static double T(maxflowBidirectional)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    struct T(MaxFlowInfo) mfi;
+    SUM maxflowVal = T(flowValue)(g, r);
+
+    T(initMaxFlowInfo)(r, &mfi, 1);
+    maxflowVal += T(augment)(r, &mfi, SOURCE_ID, SINK_ID, SUM_MAX);
+    return maxflowVal;
+}
+
+/* Capacity scaling: each phase augments only along arcs with at least
+   delta residual capacity, so that the fat paths are found first, and
+   delta halves between phases.  A last phase without a threshold picks
+   up whatever is left once delta drops below the smallest capacity. */
+static double T(maxflowScaling)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    struct T(MaxFlowInfo) mfi;
+    SUM maxflowVal = T(flowValue)(g, r);
+    CAP largest = 0, smallest = CAP_MAX, delta;
+    int a;
+
+    for(a = 0; a < r->numArcs; a++) {
+        if(RESIDUAL(r)[a] > largest)
+            largest = RESIDUAL(r)[a];
+        if(RESIDUAL(r)[a] > 0 && RESIDUAL(r)[a] < smallest)
+            smallest = RESIDUAL(r)[a];
+    }
+    /* Start from the largest power of two not above any capacity. */
+    for(delta = 1; delta <= largest / 2; delta *= 2)
+        ;
+    while(delta > largest && delta > smallest)
+        delta /= 2;
+
+    T(initMaxFlowInfo)(r, &mfi, 0);
+    for(; delta > smallest && !r->limits->stopped; delta /= 2) {
+        r->stats->phases++;
+        mfi.threshold = delta;
+        maxflowVal += T(augment)(r, &mfi, SOURCE_ID, SINK_ID, SUM_MAX);
+    }
+    mfi.threshold = 0;
+    r->stats->phases++;
+    maxflowVal += T(augment)(r, &mfi, SOURCE_ID, SINK_ID, SUM_MAX);
+    r->cutKnown = !r->limits->stopped;
+    return maxflowVal;
+}
+
+/* Leaves the vertices reachable from the source in the residual graph,
+   the source side of a minimum cut once the flow is maximum, in seen.
+   The search of the last Edmonds-Karp solve is reused if nothing has
+   changed since. */
+static void T(findCut)(FlowGraph g)
+{
+    struct Residual *r = g->residual;
+    struct T(MaxFlowInfo) mfi;
+    struct SolveStats solveStats;
+    if(r && r->cutKnown)
+        return;
+    r = residualOf(g);
+    /* The search is not part of any solve. */
+    solveStats = *r->stats;
+    T(initMaxFlowInfo)(r, &mfi, 0);
+    T(findPath)(&mfi, SOURCE_ID, -1);
+    *r->stats = solveStats;
+    r->cutKnown = 1;
+}
+
+/* --------------------------------------------------------------------------- */
+/* Capacity changes keep the current flow, so that the next solve can
+   start from it.  When a capacity drops below the flow on its edge,
+   the flow on the edge is cut back and the imbalance it leaves is
+   repaired: first by rerouting around the edge, then by returning the
+   surplus at the tail to the source and drawing the shortfall at the
+   head back from the sink. */
+
+static void T(repairFlow)(struct Residual *r, int from, int to, CAP amount)
+{
+    struct T(MaxFlowInfo) mfi;
+    struct SolveStats solveStats = *r->stats;
+    CAP rerouted;
+
+    if(from == to)
+        return;
+    T(initMaxFlowInfo)(r, &mfi, 0);
+    rerouted = (CAP) T(augment)(r, &mfi, from, to, amount);
+    if(from != SOURCE_ID && from != SINK_ID)
+        T(augment)(r, &mfi, from, SOURCE_ID, amount - rerouted);
+    if(to != SOURCE_ID && to != SINK_ID)
+        T(augment)(r, &mfi, SINK_ID, to, amount - rerouted);
+    *r->stats = solveStats;
+}
+
+/* Gives edge index, whose capacity has just been changed, arcs to
+   match. */
+static void T(setCapacity)(FlowGraph g, int index, double value)
+{
+    struct Residual *r;
+    CAP capacity = (CAP) value, flow;
+    int a;
+    if(!g->residual && g->flow[index] <= value)
+        return;
+
+    /* Update the arcs in place; the flow stays on the reverse arc. */
+    r = residualOf(g);
+    a = r->edgeArc[index];
+    flow = RESIDUAL(r)[r->rev[a]];
+    if(flow <= capacity) {
+        RESIDUAL(r)[a] = capacity - flow;
+    } else {
+        RESIDUAL(r)[a] = 0;
+        RESIDUAL(r)[r->rev[a]] = capacity;
+        T(repairFlow)(r, r->head[r->rev[a]], r->head[a], flow - capacity);
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+/* Highest-label push-relabel with the gap and global relabeling
+   heuristics, following Cherkassky and Goldberg, "On Implementing the
+   Push-Relabel Method for the Maximum Flow Problem".  The first phase
+   pushes excess toward the sink until a maximum preflow is found; the
+   second phase runs the same machinery toward the source to return
+   the excess that cannot reach the sink, leaving a proper flow on
+   every edge. */
+
+
+struct T(PushRelabelInfo) {
+    struct Residual *r;
+    int n;
+    int *height;
+    SUM *excess;
+    int *current;              /* Current arc of each vertex */
+    /* Vertices below height n are kept in buckets by height: active
+       ones on a stack and inactive ones on a doubly-linked list, so
+       that a gap can be detected and emptied quickly.  Vertices at
+       height n are dormant and belong to no bucket. */
+    int *activeFirst;
+    int *inactiveFirst;
+    int *next;
+    int *prev;
+    int maxActive;             /* No active vertex is above this height */
+    int maxHeight;             /* No bucketed vertex is above this height */
+    double work;               /* Relabel work since the last global relabel */
+    int *queue;
+};
+
+static inline void T(activeAdd)(struct T(PushRelabelInfo) *pri, int v)
+{
+    int h = pri->height[v];
+    pri->next[v] = pri->activeFirst[h];
+    pri->activeFirst[h] = v;
+    if(h > pri->maxActive)
+        pri->maxActive = h;
+    if(h > pri->maxHeight)
+        pri->maxHeight = h;
+}
+
+static inline void T(inactiveAdd)(struct T(PushRelabelInfo) *pri, int v)
+{
+    int h = pri->height[v], first = pri->inactiveFirst[h];
+    pri->next[v] = first;
+    pri->prev[v] = -1;
+    if(first >= 0)
+        pri->prev[first] = v;
+    pri->inactiveFirst[h] = v;
+    if(h > pri->maxHeight)
+        pri->maxHeight = h;
+}
+
+static inline void T(inactiveRemove)(struct T(PushRelabelInfo) *pri, int v)
+{
+    if(pri->prev[v] >= 0)
+        pri->next[pri->prev[v]] = pri->next[v];
+    else
+        pri->inactiveFirst[pri->height[v]] = pri->next[v];
+    if(pri->next[v] >= 0)
+        pri->prev[pri->next[v]] = pri->prev[v];
+}
+
+/* Sets every height to the exact residual distance to target with a
+   backward BFS and rebuilds the buckets.  Vertices that cannot reach
+   target become dormant, as does other, the opposite terminal. */
+static void T(globalRelabel)(struct T(PushRelabelInfo) *pri, int target, int other)
+{
+    struct Residual *r = pri->r;
+    int n = pri->n, head = 0, tail = 0, u, v, a, b, end;
+    uint64_t usable;
+    long arcs = 0;
+
+    for(v = 0; v < n; v++) {
+        pri->height[v] = n;
+        pri->current[v] = r->first[v];
+        pri->activeFirst[v] = -1;
+        pri->inactiveFirst[v] = -1;
+    }
+    pri->maxActive = -1;
+    pri->maxHeight = -1;
+    pri->work = 0;
+
+    pri->height[target] = 0;
+    pri->queue[tail++] = target;
+    while(head != tail) {
+        v = pri->queue[head++];
+        arcs += degree(r, v);
+        /* rev[a] is the residual arc from u to v. */
+        for(a = r->first[v], end = r->first[v + 1]; a < end; a += SCAN_WIDTH) {
+            usable = T(scanArcs)(r, a, MIN(end - a, SCAN_WIDTH), 1, 0);
+            for(; usable; usable &= usable - 1) {
+                b = a + __builtin_ctzll(usable);
+                u = r->head[b];
+                if(pri->height[u] == n && u != other) {
+                    pri->height[u] = pri->height[v] + 1;
+                    pri->queue[tail++] = u;
+                    if(pri->excess[u] > 0)
+                        T(activeAdd)(pri, u);
+                    else
+                        T(inactiveAdd)(pri, u);
+                }
+            }
+        }
+    }
+    r->stats->globalRelabels++;
+    r->stats->verticesScanned += tail;
+    r->stats->arcsScanned += arcs;
+}
+
+/* Lifts every bucketed vertex above height h, which has just become
+   empty, to dormant height n: none of them can reach the target. */
+static void T(gap)(struct T(PushRelabelInfo) *pri, int h)
+{
+    int j, v;
+    pri->r->stats->gaps++;
+    for(j = h + 1; j <= pri->maxHeight; j++) {
+        for(v = pri->activeFirst[j]; v >= 0; v = pri->next[v])
+            pri->height[v] = pri->n;
+        for(v = pri->inactiveFirst[j]; v >= 0; v = pri->next[v])
+            pri->height[v] = pri->n;
+        pri->activeFirst[j] = -1;
+        pri->inactiveFirst[j] = -1;
+    }
+    pri->maxHeight = h - 1;
+    if(pri->maxActive > h - 1)
+        pri->maxActive = h - 1;
+}
+
+/* Pushes the excess of u, which belongs to no bucket, along
+   admissible arcs, relabeling u whenever its current arc runs out. */
+static void T(discharge)(struct T(PushRelabelInfo) *pri, int u, int target)
+{
+    struct Residual *r = pri->r;
+    int n = pri->n, h, a, b, v, end = r->first[u + 1], minHeight, minArc = 0;
+    uint64_t usable;
+    CAP delta;
+
+    while(1) {
+        h = pri->height[u];
+        for(a = pri->current[u]; a < end; a++) {
+            v = r->head[a];
+            if(RESIDUAL(r)[a] > 0 && pri->height[v] == h - 1) {
+                delta = pri->excess[u] < RESIDUAL(r)[a] ?
+                        (CAP) pri->excess[u] : RESIDUAL(r)[a];
+                if(v != target && pri->excess[v] == 0) {
+                    T(inactiveRemove)(pri, v);
+                    T(activeAdd)(pri, v);
+                }
+                T(addFlow)(r, a, delta);
+                r->stats->pushes++;
+                pri->excess[u] -= delta;
+                pri->excess[v] += delta;
+                if(pri->excess[u] == 0)
+                    break;
+            }
+        }
+        if(a < end) {
+            pri->current[u] = a;
+            T(inactiveAdd)(pri, u);
+            return;
+        }
+
+        /* Relabel u; if it was the last vertex at its height, nothing
+           above that height can reach the target any more. */
+        if(pri->activeFirst[h] < 0 && pri->inactiveFirst[h] < 0) {
+            T(gap)(pri, h);
+            pri->height[u] = n;
+            return;
+        }
+        pri->work += GLOBAL_RELABEL_BETA + end - r->first[u];
+        r->stats->relabels++;
+        minHeight = n;
+        for(a = r->first[u]; a < end; a += SCAN_WIDTH) {
+            usable = T(scanArcs)(r, a, MIN(end - a, SCAN_WIDTH), 0, 0);
+            for(; usable; usable &= usable - 1) {
+                b = a + __builtin_ctzll(usable);
+                if(pri->height[r->head[b]] < minHeight) {
+                    minHeight = pri->height[r->head[b]];
+                    minArc = b;
+                }
+            }
+        }
+        if(minHeight + 1 >= n) {
+            pri->height[u] = n;
+            return;
+        }
+        pri->height[u] = minHeight + 1;
+        pri->current[u] = minArc;
+        if(minHeight + 1 > pri->maxHeight)
+            pri->maxHeight = minHeight + 1;
+    }
+}
+
+static void T(pushRelabelPhase)(struct T(PushRelabelInfo) *pri, int target, int other)
+{
+    int u;
+    pri->r->stats->phases++;
+    T(globalRelabel)(pri, target, other);
+    while(pri->maxActive >= 0) {
+        /* Only the first phase may stop early: the second one turns
+           the preflow into a flow, which any answer needs. */
+        if(target == SINK_ID && limitReached(pri->r, 256))
+            break;
+        u = pri->activeFirst[pri->maxActive];
+        if(u < 0) {
+            pri->maxActive--;
+            continue;
+        }
+        pri->activeFirst[pri->maxActive] = pri->next[u];
+        T(discharge)(pri, u, target);
+        if(pri->work * GLOBAL_RELABEL_FREQ > GLOBAL_RELABEL_ALPHA * pri->n + pri->r->numArcs)
+            T(globalRelabel)(pri, target, other);
+    }
+}
+
+/* Carves the solver state out of the scratch space and saturates every
+   arc out of the source, which starts the first phase. */
+static void T(initPushRelabel)(struct T(PushRelabelInfo) *pri, struct Residual *r)
+{
+    int n = r->numVertices, a, v;
+    CAP delta;
+
+    pri->r = r;
+    pri->n = n;
+    pri->height = r->scratch;
+    pri->current = r->scratch + n;
+    pri->activeFirst = r->scratch + 2 * n;
+    pri->inactiveFirst = r->scratch + 3 * n;
+    pri->next = r->scratch + 4 * n;
+    pri->prev = r->scratch + 5 * n;
+    pri->queue = r->scratch + 6 * n;
+    pri->excess = (SUM *) r->excess;
+    memset(pri->excess, 0, n * sizeof(SUM));
+
+    for(a = r->first[SOURCE_ID]; a < r->first[SOURCE_ID + 1]; a++) {
+        v = r->head[a];
+        delta = RESIDUAL(r)[a];
+        if(delta > 0 && v != SOURCE_ID) {
+            T(addFlow)(r, a, delta);
+            pri->excess[SOURCE_ID] -= delta;
+            pri->excess[v] += delta;
+        }
+    }
+}
+
+static double T(maxflowPushRelabel)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    struct T(PushRelabelInfo) pri;
+    SUM maxflowVal = T(flowValue)(g, r);
+
+    T(initPushRelabel)(&pri, r);
+    T(pushRelabelPhase)(&pri, SINK_ID, SOURCE_ID);
+    maxflowVal += pri.excess[SINK_ID];
+    T(pushRelabelPhase)(&pri, SOURCE_ID, SINK_ID);
+
+    return maxflowVal;
+}
+
+/* --------------------------------------------------------------------------- */
+/* Parallel push-relabel for a single large graph.  Worker threads run
+   the first phase in rounds.  Each round starts with a global relabel,
+   done as a level-synchronous parallel BFS, and then the workers
+   discharge active vertices concurrently until none are left or enough
+   relabel work has piled up for another global relabel.  A vertex is
+   owned by at most one worker at a time through its flag; excesses and
+   residual capacities, which the neighbours of a vertex also update,
+   change only through atomic additions.  Each worker keeps the
+   vertices it activates on its own queue and steals from the others
+   when that runs dry.  The phase ends when a global relabel finds no
+   active vertex that can still reach the sink, which makes the
+   preflow maximum however the concurrent pushes interleaved.  The
+   second phase, returning the excess that is left to the source, is
+   usually small and runs sequentially. */
+
+
+struct T(ParallelInfo) {
+    struct Residual *r;
+    int n;
+    int threads;
+    int *height;               /* Only the owner of a vertex raises it */
+    int *current;
+    int *flag;                 /* Set while a vertex is queued or owned */
+    int *frontier;             /* Current and next BFS levels */
+    int *nextFrontier;
+    SUM *excess;
+    struct WorkQueue *queues;
+    struct Barrier barrier;
+    int frontierSize;
+    int nextSize;
+    int claimed;               /* Next frontier chunk to hand out */
+    int pending;               /* Vertices whose flag is set */
+    int numActive;             /* Active vertices after the last relabel */
+    int stop;                  /* Ends the discharge round early */
+    int started;               /* Set once all threads are running */
+    long work;                 /* Relabel work in the current round */
+};
+
+
+
+/* Atomic additions and loads for the arc and excess types.  The
+   compare-and-swap loop works for floating point values as well. */
+static inline void T(atomicAdd)(CAP *x, CAP amount)
+{
+    CAP old, sum;
+    __atomic_load(x, &old, __ATOMIC_RELAXED);
+    do {
+        sum = old + amount;
+    } while(!__atomic_compare_exchange(x, &old, &sum, 1, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_RELAXED));
+}
+
+static inline void T(atomicAddSum)(SUM *x, SUM amount)
+{
+    SUM old, sum;
+    __atomic_load(x, &old, __ATOMIC_RELAXED);
+    do {
+        sum = old + amount;
+    } while(!__atomic_compare_exchange(x, &old, &sum, 1, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_RELAXED));
+}
+
+static inline CAP T(load)(CAP *x)
+{
+    CAP v;
+    __atomic_load(x, &v, __ATOMIC_RELAXED);
+    return v;
+}
+
+static inline SUM T(loadSum)(SUM *x)
+{
+    SUM v;
+    __atomic_load(x, &v, __ATOMIC_RELAXED);
+    return v;
+}
+
+
+/* Parallel BFS from the sink over reverse residual arcs, giving every
+   vertex its exact distance label, followed by rebuilding the queues
+   from the active vertices.  Run by all threads together. */
+static void T(parallelGlobalRelabel)(struct T(ParallelInfo) *pi, int id)
+{
+    struct Residual *r = pi->r;
+    int n = pi->n, lo = (int) ((long) n * id / pi->threads),
+        hi = (int) ((long) n * (id + 1) / pi->threads);
+    int i, end, v, u, a, level, unseen, count = 0, *swap;
+    long arcs = 0;
+
+    for(v = lo; v < hi; v++) {
+        __atomic_store_n(&pi->height[v], n, __ATOMIC_RELAXED);
+        pi->current[v] = r->first[v];
+        pi->flag[v] = 0;
+    }
+    if(id == 0) {
+        pi->queues[0].top = pi->queues[0].bottom = 0;
+        pi->frontier[0] = SINK_ID;
+        pi->frontierSize = 1;
+        pi->nextSize = 0;
+        pi->claimed = 0;
+        pi->numActive = 0;
+        pi->pending = 0;
+        pi->stop = 0;
+        pi->work = 0;
+    } else {
+        pi->queues[id].top = pi->queues[id].bottom = 0;
+    }
+    barrierWait(&pi->barrier);
+    if(id == 0)
+        pi->height[SINK_ID] = 0;
+    barrierWait(&pi->barrier);
+
+    for(level = 1; pi->frontierSize > 0; level++) {
+        while((i = __atomic_fetch_add(&pi->claimed, BFS_CHUNK, __ATOMIC_RELAXED)) <
+              pi->frontierSize) {
+            end = MIN(i + BFS_CHUNK, pi->frontierSize);
+            for(; i < end; i++) {
+                v = pi->frontier[i];
+                arcs += degree(r, v);
+                for(a = r->first[v]; a < r->first[v + 1]; a++) {
+                    u = r->head[a];
+                    unseen = n;
+                    if(u != SOURCE_ID && RESIDUAL(r)[r->rev[a]] > 0 &&
+                       __atomic_load_n(&pi->height[u], __ATOMIC_RELAXED) == n &&
+                       __atomic_compare_exchange_n(&pi->height[u], &unseen, level, 0,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                        pi->nextFrontier[__atomic_fetch_add(&pi->nextSize, 1,
+                                                            __ATOMIC_RELAXED)] = u;
+                }
+            }
+        }
+        barrierWait(&pi->barrier);
+        if(id == 0) {
+            r->stats->verticesScanned += pi->frontierSize;
+            swap = pi->frontier;
+            pi->frontier = pi->nextFrontier;
+            pi->nextFrontier = swap;
+            pi->frontierSize = pi->nextSize;
+            pi->nextSize = 0;
+            pi->claimed = 0;
+        }
+        barrierWait(&pi->barrier);
+    }
+
+    for(v = lo; v < hi; v++) {
+        if(v != SOURCE_ID && v != SINK_ID && pi->height[v] < n && pi->excess[v] > 0) {
+            pi->flag[v] = 1;
+            queuePush(&pi->queues[id], v);
+            count++;
+        }
+    }
+    if(id == 0)
+        r->stats->globalRelabels++;
+    __atomic_fetch_add(&r->stats->arcsScanned, arcs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pi->numActive, count, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&pi->pending, count, __ATOMIC_SEQ_CST);
+    barrierWait(&pi->barrier);
+}
+
+/* Discharges u, which the calling worker owns, much like discharge()
+   but with atomic updates and without buckets or gaps: heights read
+   from other vertices may be stale, so an arc is used while the head
+   looks lower, and the next global relabel corrects the rest. */
+static void T(parallelDischarge)(struct T(ParallelInfo) *pi, struct WorkQueue *q, int u)
+{
+    struct Residual *r = pi->r;
+    int n = pi->n, h, a, v, end = r->first[u + 1], minHeight, minArc = 0, idle;
+    long pushes = 0, relabels = 0;
+    CAP delta, residual;
+    SUM excess;
+
+    while(1) {
+        h = pi->height[u];
+        for(a = pi->current[u]; a < end; a++) {
+            v = r->head[a];
+            residual = T(load)(&RESIDUAL(r)[a]);
+            if(residual > 0 && __atomic_load_n(&pi->height[v], __ATOMIC_RELAXED) < h) {
+                /* Only u's owner lowers its excess or this residual. */
+                excess = T(loadSum)(&pi->excess[u]);
+                delta = excess < residual ? (CAP) excess : residual;
+                T(atomicAdd)(&RESIDUAL(r)[a], -delta);
+                T(atomicAdd)(&RESIDUAL(r)[r->rev[a]], delta);
+                T(atomicAddSum)(&pi->excess[u], -delta);
+                T(atomicAddSum)(&pi->excess[v], delta);
+                pushes++;
+                idle = 0;
+                if(v != SINK_ID && __atomic_compare_exchange_n(&pi->flag[v], &idle, 1, 0,
+                                                               __ATOMIC_SEQ_CST,
+                                                               __ATOMIC_SEQ_CST)) {
+                    __atomic_fetch_add(&pi->pending, 1, __ATOMIC_SEQ_CST);
+                    queuePush(q, v);
+                }
+                if(delta == excess)
+                    break;
+            }
+        }
+        if(a < end) {
+            pi->current[u] = a;
+            break;
+        }
+
+        __atomic_fetch_add(&pi->work, GLOBAL_RELABEL_BETA + end - r->first[u],
+                           __ATOMIC_RELAXED);
+        relabels++;
+        minHeight = n;
+        for(a = r->first[u]; a < end; a++) {
+            v = r->head[a];
+            if(T(load)(&RESIDUAL(r)[a]) > 0 &&
+               __atomic_load_n(&pi->height[v], __ATOMIC_RELAXED) < minHeight) {
+                minHeight = __atomic_load_n(&pi->height[v], __ATOMIC_RELAXED);
+                minArc = a;
+            }
+        }
+        if(minHeight + 1 >= n) {
+            __atomic_store_n(&pi->height[u], n, __ATOMIC_RELAXED);
+            break;
+        }
+        __atomic_store_n(&pi->height[u], minHeight + 1, __ATOMIC_RELAXED);
+        pi->current[u] = minArc;
+    }
+    __atomic_fetch_add(&r->stats->pushes, pushes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->stats->relabels, relabels, __ATOMIC_RELAXED);
+}
+
+static void T(parallelRound)(struct T(ParallelInfo) *pi, int id)
+{
+    struct WorkQueue *q = &pi->queues[id];
+    long limit = ((long) GLOBAL_RELABEL_ALPHA * pi->n + pi->r->numArcs) / GLOBAL_RELABEL_FREQ;
+    int u, i, idle;
+
+    while(!__atomic_load_n(&pi->stop, __ATOMIC_RELAXED)) {
+        if(id == 0 && limitReached(pi->r, 256)) {
+            __atomic_store_n(&pi->stop, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        u = queueTake(q, 0);
+        for(i = 1; u < 0 && i < pi->threads; i++)
+            u = queueTake(&pi->queues[(id + i) % pi->threads], 1);
+        if(u < 0) {
+            if(__atomic_load_n(&pi->pending, __ATOMIC_SEQ_CST) == 0)
+                break;
+            sched_yield();
+            continue;
+        }
+        for(;;) {
+            if(pi->height[u] < pi->n)
+                T(parallelDischarge)(pi, q, u);
+            /* Give u up, unless excess arrived after the discharge.
+               Once flag[u] is clear another worker may take u. */
+            __atomic_store_n(&pi->flag[u], 0, __ATOMIC_SEQ_CST);
+            idle = 0;
+            if(__atomic_load_n(&pi->height[u], __ATOMIC_RELAXED) < pi->n && T(loadSum)(&pi->excess[u]) > 0 &&
+               __atomic_compare_exchange_n(&pi->flag[u], &idle, 1, 0,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+                continue;
+            break;
+        }
+        __atomic_fetch_sub(&pi->pending, 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&pi->work, __ATOMIC_RELAXED) > limit)
+            __atomic_store_n(&pi->stop, 1, __ATOMIC_RELAXED);
+    }
+    barrierWait(&pi->barrier);
+}
+
+struct T(Worker) {
+    struct T(ParallelInfo) *pi;
+    int id;
+    pthread_t thread;
+};
+
+static void *T(parallelWorker)(void *arg)
+{
+    struct T(Worker) *w = (struct T(Worker) *) arg;
+    struct T(ParallelInfo) *pi = w->pi;
+
+    /* Wait until the number of threads is settled. */
+    pthread_mutex_lock(&pi->barrier.lock);
+    while(!pi->started)
+        pthread_cond_wait(&pi->barrier.cond, &pi->barrier.lock);
+    pthread_mutex_unlock(&pi->barrier.lock);
+
+    while(1) {
+        T(parallelGlobalRelabel)(pi, w->id);
+        if(pi->numActive == 0)
+            return NULL;
+        T(parallelRound)(pi, w->id);
+        if(pi->r->limits->stopped)
+            return NULL;
+    }
+}
+
+
+static double T(maxflowParallel)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    struct T(PushRelabelInfo) pri;
+    struct T(ParallelInfo) pi;
+    struct T(Worker) *workers;
+    SUM maxflowVal = T(flowValue)(g, r);
+    int n = r->numVertices, threads, t, started;
+
+    threads = g->threads > 0 ? g->threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads < 1)
+        threads = 1;
+    T(initPushRelabel)(&pri, r);
+    pi.r = r;
+    pi.n = n;
+    pi.height = r->scratch;
+    pi.current = r->scratch + n;
+    pi.frontier = r->scratch + 2 * n;
+    pi.nextFrontier = r->scratch + 3 * n;
+    pi.flag = r->scratch + 4 * n;
+    pi.excess = (SUM *) r->excess;
+    pi.started = 0;
+    pi.queues = (struct WorkQueue *) calloc(threads, sizeof(struct WorkQueue));
+    workers = (struct T(Worker) *) malloc(threads * sizeof(struct T(Worker)));
+    pthread_mutex_init(&pi.barrier.lock, NULL);
+    pthread_cond_init(&pi.barrier.cond, NULL);
+    pi.barrier.waiting = 0;
+    pi.barrier.cycle = 0;
+
+    /* The calling thread is worker 0; run with however many of the
+       others could be started. */
+    for(t = 0; t < threads; t++) {
+        pthread_mutex_init(&pi.queues[t].lock, NULL);
+        workers[t].pi = &pi;
+        workers[t].id = t;
+    }
+    for(started = 1; started < threads; started++)
+        if(pthread_create(&workers[started].thread, NULL, T(parallelWorker),
+                          &workers[started]) != 0)
+            break;
+    pthread_mutex_lock(&pi.barrier.lock);
+    pi.threads = started;
+    pi.barrier.count = started;
+    pi.started = 1;
+    pthread_cond_broadcast(&pi.barrier.cond);
+    pthread_mutex_unlock(&pi.barrier.lock);
+    r->stats->phases++;
+    T(parallelWorker)(&workers[0]);
+    for(t = 1; t < started; t++)
+        pthread_join(workers[t].thread, NULL);
+
+    for(t = 0; t < threads; t++) {
+        pthread_mutex_destroy(&pi.queues[t].lock);
+        free(pi.queues[t].items);
+    }
+    pthread_cond_destroy(&pi.barrier.cond);
+    pthread_mutex_destroy(&pi.barrier.lock);
+    free(pi.queues);
+    free(workers);
+
+    maxflowVal += pi.excess[SINK_ID];
+    T(pushRelabelPhase)(&pri, SOURCE_ID, SINK_ID);
+    return maxflowVal;
+}
+
+/* --------------------------------------------------------------------------- */
+/* Dinic's algorithm: each phase builds the BFS level graph from the
+   source once and saturates a blocking flow in it with a depth-first
+   search that remembers, per vertex, the first arc that may still be
+   usable (the current arc). */
+
+struct T(DinicInfo) {
+    struct Residual *r;
+    int *level;
+    int *current;              /* Current arc of each vertex */
+    int *queue;
+    int *path;                 /* Arcs of the partial source-sink path */
+};
+
+static int T(buildLevels)(struct T(DinicInfo) *di)
+{
+    struct Residual *r = di->r;
+    int head = 0, tail = 0, u, v, a, b, end;
+    uint64_t usable;
+
+    for(v = 0; v < r->numVertices; v++)
+        di->level[v] = -1;
+    di->level[SOURCE_ID] = 0;
+    di->queue[tail++] = SOURCE_ID;
+    while(head != tail) {
+        u = di->queue[head++];
+        /* Vertices at or beyond the sink's level cannot be on a
+           shortest augmenting path. */
+        if(di->level[SINK_ID] >= 0 && di->level[u] >= di->level[SINK_ID])
+            break;
+        r->stats->arcsScanned += degree(r, u);
+        for(a = r->first[u], end = r->first[u + 1]; a < end; a += SCAN_WIDTH) {
+            usable = T(scanArcs)(r, a, MIN(end - a, SCAN_WIDTH), 0, 0);
+            for(; usable; usable &= usable - 1) {
+                b = a + __builtin_ctzll(usable);
+                v = r->head[b];
+                if(di->level[v] < 0) {
+                    di->level[v] = di->level[u] + 1;
+                    di->queue[tail++] = v;
+                }
+            }
+        }
+    }
+    r->stats->verticesScanned += tail;
+    if(di->level[SINK_ID] < 0)
+        return 0;
+    r->stats->phases++;
+    return 1;
+}
+
+static SUM T(blockingFlow)(struct T(DinicInfo) *di)
+{
+    struct Residual *r = di->r;
+    int u, depth = 0, i, a, end, bottleneckAt;
+    CAP increment;
+    SUM total = 0;
+
+    for(u = 0; u < r->numVertices; u++)
+        di->current[u] = r->first[u];
+    u = SOURCE_ID;
+    while(1) {
+        if(u == SINK_ID) {
+            /* Augment along the path and retreat to the tail of its
+               first bottleneck arc, which is now saturated. */
+            increment = CAP_MAX;
+            bottleneckAt = 0;
+            for(i = 0; i < depth; i++) {
+                if(RESIDUAL(r)[di->path[i]] < increment) {
+                    increment = RESIDUAL(r)[di->path[i]];
+                    bottleneckAt = i;
+                }
+            }
+            for(i = 0; i < depth; i++)
+                T(addFlow)(r, di->path[i], increment);
+            r->stats->augmentations++;
+            total += increment;
+            if(limitReached(r, 64))
+                break;
+            depth = bottleneckAt;
+            u = r->head[r->rev[di->path[depth]]];
+            continue;
+        }
+        /* Advance along the current arc, skipping unusable ones. */
+        for(a = di->current[u], end = r->first[u + 1]; a < end; a++)
+            if(RESIDUAL(r)[a] > 0 && di->level[r->head[a]] == di->level[u] + 1)
+                break;
+        di->current[u] = a;
+        if(a < end) {
+            di->path[depth++] = a;
+            u = r->head[a];
+            continue;
+        }
+        /* Dead end: retreat and give up the arc that led here. */
+        if(u == SOURCE_ID)
+            break;
+        u = r->head[r->rev[di->path[--depth]]];
+        di->current[u]++;
+    }
+    return total;
+}
+
+static double T(maxflowDinic)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    int n = r->numVertices;
+    struct T(DinicInfo) di;
+    SUM maxflowVal = T(flowValue)(g, r);
+
+    di.r = r;
+    di.level = r->scratch;
+    di.current = r->scratch + n;
+    di.queue = r->scratch + 2 * n;
+    di.path = r->scratch + 3 * n;
+
+    while(!limitReached(r, 1) && T(buildLevels)(&di))
+        maxflowVal += T(blockingFlow)(&di);
+
+    return maxflowVal;
+}
+
+/* --------------------------------------------------------------------------- */
+/* Min-cost max flow by successive shortest paths: each augmentation
+   follows a cheapest path, found by Dijkstra's algorithm on costs made
+   non-negative by vertex potentials (Edmonds and Karp, "Theoretical
+   Improvements in Algorithmic Efficiency for Network Flow Problems").
+   The flow after every augmentation costs the least of any flow of its
+   value, which is what makes the potentials valid throughout. */
+
+/* Pushes as much flow as fits around the negative cycle that the pred
+   arcs lead back to from v.  Returns 0 if they lead nowhere. */
+static int T(cancelCycle)(struct Residual *r, const int *pred, int v)
+{
+    CAP increment = CAP_MAX;
+    int i, u;
+
+    /* Walking back numVertices arcs lands on the cycle. */
+    for(i = 0; i < r->numVertices; i++) {
+        if(pred[v] < 0)
+            return 0;
+        v = r->head[r->rev[pred[v]]];
+    }
+    u = v;
+    do {
+        increment = MIN(increment, RESIDUAL(r)[pred[u]]);
+        u = r->head[r->rev[pred[u]]];
+    } while(u != v);
+    do {
+        T(addFlow)(r, pred[u], increment);
+        u = r->head[r->rev[pred[u]]];
+    } while(u != v);
+    r->stats->augmentations++;
+    return 1;
+}
+
+/* Finds potentials under which no arc with residual capacity has a
+   negative reduced cost, by Bellman-Ford from all vertices at once.
+   Returns -1, or a vertex whose pred arcs lead back to a negative cycle
+   if there is one. */
+static int T(bellmanFord)(struct Residual *r, double *pi, int *pred)
+{
+    int n = r->numVertices, round, u, v, a, changed = -1;
+    double d;
+
+    for(u = 0; u < n; u++) {
+        pi[u] = 0;
+        pred[u] = -1;
+    }
+    for(round = 0; round < n; round++) {
+        r->stats->phases++;
+        changed = -1;
+        for(u = 0; u < n; u++) {
+            for(a = r->first[u]; a < r->first[u + 1]; a++) {
+                v = r->head[a];
+                d = pi[u] + r->arcCost[a];
+                if(RESIDUAL(r)[a] > 0 && d < pi[v] - COST_EPSILON * (1 + fabs(pi[v]))) {
+                    pi[v] = d;
+                    pred[v] = a;
+                    changed = v;
+                }
+            }
+        }
+        r->stats->arcsScanned += r->numArcs;
+        if(changed < 0)
+            break;
+    }
+    return changed;
+}
+
+/* Dijkstra's algorithm from the source on reduced costs, leaving the
+   distances in dist, the arc into each vertex in pred and the vertices
+   whose distance is final in seen.  Stops at the sink and returns
+   whether it was reached. */
+static int T(cheapestPath)(struct Residual *r, const double *pi, double *dist, int *pred,
+                          struct Heap *heap)
+{
+    int n = r->numVertices, u, v, a;
+    double d;
+
+    for(v = 0; v < n; v++) {
+        dist[v] = HUGE_VAL;
+        heap->pos[v] = -1;
+    }
+    setClear(&r->seen);
+    heap->size = 0;
+    dist[SOURCE_ID] = 0;
+    pred[SOURCE_ID] = -1;
+    heapUpdate(heap, SOURCE_ID);
+    while(heap->size > 0) {
+        u = heapPop(heap);
+        setAdd(&r->seen, u);
+        r->stats->verticesScanned++;
+        if(u == SINK_ID)
+            return 1;
+        r->stats->arcsScanned += degree(r, u);
+        for(a = r->first[u]; a < r->first[u + 1]; a++) {
+            v = r->head[a];
+            if(RESIDUAL(r)[a] <= 0 || setHas(&r->seen, v))
+                continue;
+            /* Rounding can leave reduced costs just below zero. */
+            d = r->arcCost[a] + pi[u] - pi[v];
+            d = dist[u] + (d > 0 ? d : 0);
+            if(d < dist[v]) {
+                dist[v] = d;
+                pred[v] = a;
+                heapUpdate(heap, v);
+            }
+        }
+    }
+    return 0;
+}
+
+static double T(maxflowMinCost)(FlowGraph g)
+{
+    struct Residual *r = residualOf(g);
+    int n = r->numVertices, *pred = r->scratch + 2 * n, a, v, cycle;
+    double *pi = r->potential, *dist = pi + n, reach;
+    struct Heap heap;
+    SUM maxflowVal;
+    CAP increment;
+
+    /* Without costs every maximum flow is cheapest. */
+    if(!r->arcCost)
+        return T(maxflow)(g);
+
+    /* Make the starting flow the cheapest of its value, so that warm
+       starts and negative costs need no special case, then find the
+       first potentials.  With no residual arc of negative cost, zero
+       potentials already do. */
+    for(a = 0; a < r->numArcs && !(RESIDUAL(r)[a] > 0 && r->arcCost[a] < 0); a++)
+        ;
+    if(a < r->numArcs) {
+        while((cycle = T(bellmanFord)(r, pi, pred)) >= 0 && T(cancelCycle)(r, pred, cycle))
+            ;
+    } else {
+        for(v = 0; v < n; v++)
+            pi[v] = 0;
+    }
+
+    heap.item = r->scratch;
+    heap.pos = r->scratch + n;
+    heap.key = dist;
+    maxflowVal = T(flowValue)(g, r);
+    while(!limitReached(r, 1) && T(cheapestPath)(r, pi, dist, pred, &heap)) {
+        increment = CAP_MAX;
+        for(v = SINK_ID; v != SOURCE_ID; v = r->head[r->rev[pred[v]]])
+            increment = MIN(increment, RESIDUAL(r)[pred[v]]);
+        for(v = SINK_ID; v != SOURCE_ID; v = r->head[r->rev[pred[v]]])
+            T(addFlow)(r, pred[v], increment);
+        r->stats->augmentations++;
+        maxflowVal += increment;
+        /* Vertices the search did not settle are at least as far as the
+           sink, and moving them by its distance keeps every residual
+           arc's reduced cost non-negative. */
+        reach = dist[SINK_ID];
+        for(v = 0; v < n; v++)
+            pi[v] += setHas(&r->seen, v) ? dist[v] : reach;
+    }
+    r->cutKnown = !r->limits->stopped;
+    return maxflowVal;
+}
+
+static void T(resetFlows)(FlowGraph g)
+{
+    struct Residual *r = g->residual;
+    int i, a;
+    if(r)
+        r->cutKnown = 0;
+    for(i = 0; i < g->numEdges; i++) {
+        if(g->flow)
+            g->flow[i] = 0.0;
+        if(r) {
+            /* Without the edge arrays, the capacity is in the arcs. */
+            a = r->edgeArc[i];
+            RESIDUAL(r)[a] = g->capacity ? (CAP) g->capacity[i] :
+                             RESIDUAL(r)[a] + RESIDUAL(r)[r->rev[a]];
+            RESIDUAL(r)[r->rev[a]] = 0;
+        }
+    }
+    for(i = 0; r && i < r->numTerminalArcs; i++) {
+        a = r->edgeArc[g->numEdges + i];
+        RESIDUAL(r)[a] = (CAP) r->terminalCapacity[i];
+        RESIDUAL(r)[r->rev[a]] = 0;
+    }
+}
+
+static const struct Engine T(engine) = {
+    sizeof(CAP),
+    CAP_LIMIT,
+    sizeof(SUM),
+    T(loadArcs),
+    T(storeFlows),
+    T(storeCapacities),
+    T(arcValue),
+    T(getFlows),
+    T(setCapacity),
+    T(resetFlows),
+    T(findCut),
+    T(maxflow),
+    T(maxflowBidirectional),
+    T(maxflowScaling),
+    T(maxflowPushRelabel),
+    T(maxflowParallel),
+    T(maxflowDinic),
+    T(maxflowMinCost)
+};
+
+#undef T
+#undef RESIDUAL
+#undef CAP
+#undef SUM
+#undef CAP_MAX
+#undef CAP_LIMIT
+#undef SUM_MAX
+#undef SUFFIX
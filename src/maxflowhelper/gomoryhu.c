@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "gomoryhu.h"
+#include "batch.h"
+
+struct CutTree {
+    int numVertices;
+    int *parent;
+    double *weight;
+    /* For queries, the tree edges are merged in order of decreasing
+       weight into a binary tree whose leaves are the vertices, merge i
+       being node numVertices + i.  A merge lies above everything it
+       joined, so the minimum cut between two vertices is the weight of
+       their lowest common ancestor, found along heavy paths: up is the
+       parent of each node, depth its distance from the root and head
+       the top of its heavy path. */
+    int *up;
+    int *depth;
+    int *head;
+    double *nodeWeight;
+};
+
+struct TreeEdge {
+    double weight;
+    int vertex;
+};
+
+static int compareEdges(const void *x, const void *y)
+{
+    double a = ((const struct TreeEdge *) x)->weight, b = ((const struct TreeEdge *) y)->weight;
+    return a > b ? -1 : a < b;
+}
+
+static int findSet(int *set, int v)
+{
+    while(set[v] != v)
+        v = set[v] = set[set[v]];
+    return v;
+}
+
+static void buildQueries(CutTree tree)
+{
+    int n = tree->numVertices, nodes = 2 * n - 1, *set, *top, *size, *heavy, i, a, b, x;
+    struct TreeEdge *edges;
+
+    tree->up = (int *) malloc(nodes * sizeof(int));
+    tree->depth = (int *) malloc(nodes * sizeof(int));
+    tree->head = (int *) malloc(nodes * sizeof(int));
+    tree->nodeWeight = (double *) malloc(nodes * sizeof(double));
+    set = (int *) malloc(2 * n * sizeof(int));
+    top = set + n;
+    edges = (struct TreeEdge *) malloc(n * sizeof(struct TreeEdge));
+    for(i = 1; i < n; i++) {
+        edges[i - 1].weight = tree->weight[i];
+        edges[i - 1].vertex = i;
+    }
+    qsort(edges, n - 1, sizeof(struct TreeEdge), compareEdges);
+
+    /* Kruskal's algorithm, with top the node standing for each set. */
+    for(i = 0; i < n; i++) {
+        set[i] = top[i] = i;
+        tree->nodeWeight[i] = HUGE_VAL;
+    }
+    tree->up[nodes - 1] = -1;
+    for(i = 0; i < n - 1; i++) {
+        a = findSet(set, edges[i].vertex);
+        b = findSet(set, tree->parent[edges[i].vertex]);
+        x = n + i;
+        tree->up[top[a]] = tree->up[top[b]] = x;
+        tree->nodeWeight[x] = edges[i].weight;
+        set[a] = b;
+        top[b] = x;
+    }
+    free(edges);
+    free(set);
+
+    /* Every node comes before its parent. */
+    size = (int *) malloc(2 * nodes * sizeof(int));
+    heavy = size + nodes;
+    for(x = 0; x < nodes; x++) {
+        size[x] = 1;
+        heavy[x] = -1;
+    }
+    for(x = 0; x < nodes - 1; x++) {
+        size[tree->up[x]] += size[x];
+        if(heavy[tree->up[x]] < 0 || size[x] > size[heavy[tree->up[x]]])
+            heavy[tree->up[x]] = x;
+    }
+    for(x = nodes - 1; x >= 0; x--) {
+        if(tree->up[x] < 0) {
+            tree->depth[x] = 0;
+            tree->head[x] = x;
+        } else {
+            tree->depth[x] = tree->depth[tree->up[x]] + 1;
+            tree->head[x] = heavy[tree->up[x]] == x ? tree->head[tree->up[x]] : x;
+        }
+    }
+    free(size);
+}
+
+CutTree CutTree_build(FlowGraph g, double (*solve)(FlowGraph g), int threads)
+{
+    CutTree tree = (CutTree) malloc(sizeof(*tree));
+    int n = Graph_numVertices(g), m = Graph_numEdges(g), *from, *to, *cut, *dst,
+        next, batch, i, k, v, t, count, swap;
+    double *capacity;
+    struct BatchJob *jobs;
+
+    tree->numVertices = n;
+    tree->parent = (int *) malloc(n * sizeof(int));
+    tree->weight = (double *) malloc(n * sizeof(double));
+    for(v = 0; v < n; v++) {
+        tree->parent[v] = 0;
+        tree->weight[v] = 0;
+    }
+    tree->parent[0] = -1;
+
+    if(threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > n - 1)
+        threads = n - 1;
+    if(threads < 1)
+        threads = 1;
+
+    /* Each copy has every edge both ways, and a vertex for every id. */
+    from = (int *) malloc((2 * m + 1) * sizeof(int));
+    to = (int *) malloc((2 * m + 1) * sizeof(int));
+    capacity = (double *) malloc((2 * m + 1) * sizeof(double));
+    Graph_getEdges(g, from, to, capacity);
+    for(i = 0; i < m; i++) {
+        from[m + i] = to[i];
+        to[m + i] = from[i];
+        capacity[m + i] = capacity[i];
+    }
+    from[2 * m] = to[2 * m] = n - 1;
+    capacity[2 * m] = 0;
+    jobs = (struct BatchJob *) calloc(threads, sizeof(struct BatchJob));
+    for(k = 0; k < threads; k++) {
+        if(!(jobs[k].graph = Graph_newTyped(n, 2 * m + 1, Graph_capacityType(g))))
+            break;
+        if(!Graph_addEdges(jobs[k].graph, from, to, capacity, 2 * m + 1)) {
+            Graph_free(jobs[k].graph);
+            break;
+        }
+    }
+    free(from);
+    free(to);
+    free(capacity);
+    if(k < threads) {
+        while(k > 0)
+            Graph_free(jobs[--k].graph);
+        free(jobs);
+        free(tree->parent);
+        free(tree->weight);
+        free(tree);
+        return NULL;
+    }
+
+    /* Gusfield's algorithm: the cut between v and its parent so far
+       moves the other vertices on v's side with the same parent under
+       v, and if the parent's own parent is on v's side too, v takes the
+       parent's place in the tree, so that every tree edge is a minimum
+       cut.  Only vertices already done are swapped, so a batch solves
+       the cuts of consecutive vertices against the parents they have
+       before it, and keeps them up to the first vertex whose parent an
+       earlier cut in the batch moved. */
+    cut = (int *) malloc((n + threads) * sizeof(int));
+    dst = cut + n;
+    for(next = 1; next < n; next += k) {
+        batch = n - next < threads ? n - next : threads;
+        for(k = 0; k < batch; k++) {
+            v = next + k;
+            dst[k] = tree->parent[v];
+            Graph_setSolveTerminals(jobs[k].graph, &v, 1, dst + k, 1);
+        }
+        Batch_run(jobs, batch, solve, batch);
+        for(k = 0; k < batch; k++) {
+            v = next + k;
+            if(tree->parent[v] != dst[k])
+                break;
+            t = dst[k];
+            tree->weight[v] = jobs[k].maxflow;
+            count = Graph_minCut(jobs[k].graph, cut);
+            swap = 0;
+            for(i = 0; i < count; i++) {
+                if(cut[i] != v && tree->parent[cut[i]] == t)
+                    tree->parent[cut[i]] = v;
+                else if(cut[i] == tree->parent[t])
+                    swap = 1;
+            }
+            if(swap) {
+                tree->parent[v] = tree->parent[t];
+                tree->parent[t] = v;
+                tree->weight[v] = tree->weight[t];
+                tree->weight[t] = jobs[k].maxflow;
+            }
+        }
+    }
+    free(cut);
+    for(k = 0; k < threads; k++)
+        Graph_free(jobs[k].graph);
+    free(jobs);
+
+    buildQueries(tree);
+    return tree;
+}
+
+void CutTree_free(CutTree tree)
+{
+    free(tree->parent);
+    free(tree->weight);
+    free(tree->up);
+    free(tree->depth);
+    free(tree->head);
+    free(tree->nodeWeight);
+    free(tree);
+}
+
+int CutTree_numVertices(CutTree tree)
+{
+    return tree->numVertices;
+}
+
+const int *CutTree_parents(CutTree tree)
+{
+    return tree->parent;
+}
+
+const double *CutTree_weights(CutTree tree)
+{
+    return tree->weight;
+}
+
+double CutTree_minCut(CutTree tree, int u, int v)
+{
+    const int *up = tree->up, *depth = tree->depth, *head = tree->head;
+    while(head[u] != head[v]) {
+        if(depth[head[u]] > depth[head[v]])
+            u = up[head[u]];
+        else
+            v = up[head[v]];
+    }
+    return tree->nodeWeight[depth[u] < depth[v] ? u : v];
+}
@@ -0,0 +1,30 @@
+#ifndef GOMORYHU_INCLUDED
+#define GOMORYHU_INCLUDED
+
+#include "flowgraph.h"
+
+/* A Gomory-Hu tree of a graph whose edges are taken as undirected: the
+   minimum cut between any two vertices is the smallest weight on the
+   tree path between them, and removing a tree edge splits the vertices
+   by a minimum cut between its ends.  Vertex v hangs off parent[v] by
+   an edge of weight[v]; vertex 0 is the root, with parent -1 and
+   weight 0. */
+typedef struct CutTree *CutTree;
+
+/* Builds the tree with Gusfield's algorithm, one minimum cut per vertex
+   but the root, every cut solved with solve on the same copy of the
+   graph.  With threads other than 1 (0 for one per processor), that
+   many copies solve the cuts for consecutive vertices at once; a cut
+   that the cuts before it show was made against the wrong neighbour is
+   solved again.  Returns NULL if the copies cannot be allocated.  Must
+   be called without holding any interpreter lock. */
+CutTree CutTree_build(FlowGraph g, double (*solve)(FlowGraph g), int threads);
+void CutTree_free(CutTree tree);
+int CutTree_numVertices(CutTree tree);
+const int *CutTree_parents(CutTree tree);
+const double *CutTree_weights(CutTree tree);
+/* Returns the minimum cut between vertices u and v, which must differ,
+   in time logarithmic in the number of vertices. */
+double CutTree_minCut(CutTree tree, int u, int v);
+
+#endif /* GOMORYHU_INCLUDED */
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graphfile.h"
+
+#define PAD8(x) (((x) + 7) & ~(int64_t) 7)
+
+static size_t capacitySize(CapacityType type)
+{
+    return type == CAP_DOUBLE || type == CAP_INT64 ? 8 : 4;
+}
+
+/* Stores capacity at position i of an array of the given type. */
+static void storeCapacity(void *capacities, CapacityType type, int i, double capacity)
+{
+    switch(type) {
+    case CAP_DOUBLE: ((double *) capacities)[i] = capacity;            break;
+    case CAP_INT32:  ((int32_t *) capacities)[i] = (int32_t) capacity; break;
+    case CAP_INT64:  ((int64_t *) capacities)[i] = (int64_t) capacity; break;
+    default:         ((float *) capacities)[i] = (float) capacity;     break;
+    }
+}
+
+int GraphFile_write(FlowGraph g, const char *path)
+{
+    struct GraphFileHeader header;
+    CapacityType type = Graph_capacityType(g);
+    int n = Graph_numVertices(g), m = Graph_numEdges(g), i, v, ok, saved, hasCosts = 0;
+    int *from, *to, *heads, *pos;
+    int64_t *first;
+    double *capacity, *costs;
+    void *capacities;
+    size_t capacityBytes = m * capacitySize(type);
+    char padding[8] = {0};
+    FILE *f;
+
+    from = (int *) malloc((m + 1) * sizeof(int));
+    to = (int *) malloc((m + 1) * sizeof(int));
+    heads = (int *) malloc((m + 1) * sizeof(int));
+    pos = (int *) malloc(n * sizeof(int));
+    first = (int64_t *) calloc(n + 1, sizeof(int64_t));
+    capacity = (double *) malloc((m + 1) * sizeof(double));
+    capacities = malloc((m + 1) * capacitySize(type));
+    costs = (double *) malloc((m + 1) * sizeof(double));
+    ok = from && to && heads && pos && first && capacity && capacities && costs;
+    if(!ok) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    /* Counting sort on the tails, which keeps the insertion order of
+       the edges out of each vertex. */
+    Graph_getEdges(g, from, to, capacity);
+    for(i = 0; i < m; i++)
+        first[from[i] + 1]++;
+    for(v = 0; v < n; v++) {
+        first[v + 1] += first[v];
+        pos[v] = (int) first[v];
+    }
+    for(i = 0; i < m; i++) {
+        heads[pos[from[i]]] = to[i];
+        costs[pos[from[i]]] = Graph_getEdgeCost(g, i);
+        hasCosts |= costs[pos[from[i]]] != 0;
+        storeCapacity(capacities, type, pos[from[i]]++, capacity[i]);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GRAPHFILE_MAGIC, sizeof(GRAPHFILE_MAGIC));
+    header.byteOrder = GRAPHFILE_BYTE_ORDER;
+    header.version = GRAPHFILE_VERSION;
+    header.capacityType = type;
+    header.flags = hasCosts ? GRAPHFILE_COSTS : 0;
+    Graph_getTerminals(g, &header.source, &header.sink);
+    header.numVertices = n;
+    header.numEdges = m;
+
+    if(!(f = fopen(path, "wb"))) {
+        ok = 0;
+        goto done;
+    }
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(first, sizeof(int64_t), n + 1, f) == (size_t) n + 1 &&
+         fwrite(heads, sizeof(int), m, f) == (size_t) m &&
+         fwrite(padding, 1, PAD8(m * sizeof(int)) - m * sizeof(int), f) ==
+             PAD8(m * sizeof(int)) - m * sizeof(int) &&
+         fwrite(capacities, capacitySize(type), m, f) == (size_t) m &&
+         (!hasCosts ||
+          (fwrite(padding, 1, PAD8(capacityBytes) - capacityBytes, f) ==
+               PAD8(capacityBytes) - capacityBytes &&
+           fwrite(costs, sizeof(double), m, f) == (size_t) m));
+    saved = errno;
+    if(fclose(f) != 0 && ok) {
+        ok = 0;
+        saved = errno;
+    }
+    errno = saved;
+
+done:
+    saved = errno;
+    free(from);
+    free(to);
+    free(heads);
+    free(pos);
+    free(first);
+    free(capacity);
+    free(capacities);
+    free(costs);
+    errno = saved;
+    return ok;
+}
+
+/* Checks the header and offsets of a mapped file of the given size and
+   returns NULL if they hold up, or what is wrong. */
+static const char *checkFile(const char *data, int64_t size)
+{
+    const struct GraphFileHeader *header = (const struct GraphFileHeader *) data;
+    const int64_t *first;
+    const int *heads;
+    int64_t n, m, i, expected, capacityBytes;
+
+    if(size < (int64_t) sizeof(*header) ||
+       memcmp(header->magic, GRAPHFILE_MAGIC, sizeof(GRAPHFILE_MAGIC)) != 0)
+        return "not a graph file";
+    if(header->byteOrder != GRAPHFILE_BYTE_ORDER)
+        return "graph file has the wrong byte order";
+    if(header->version < 1 || header->version > GRAPHFILE_VERSION)
+        return "unsupported graph file version";
+    if((header->version == 1 && header->flags != 0) || (header->flags & ~GRAPHFILE_COSTS))
+        return "bad graph file header";
+    if(header->capacityType > CAP_INT64)
+        return "unknown capacity type in graph file";
+    n = header->numVertices;
+    m = header->numEdges;
+    if(n < 0 || n >= INT_MAX || m < 0 || m > GRAPH_MAX_EDGES ||
+       header->source < 0 || header->sink < 0 || header->source == header->sink ||
+       header->source >= n || header->sink >= n)
+        return "bad graph file header";
+    capacityBytes = m * capacitySize(header->capacityType);
+    expected = sizeof(*header) + (n + 1) * sizeof(int64_t) +
+               PAD8(m * sizeof(int)) + capacityBytes;
+    if(header->flags & GRAPHFILE_COSTS)
+        expected = expected - capacityBytes + PAD8(capacityBytes) + m * sizeof(double);
+    if(size != expected)
+        return "graph file has the wrong size";
+
+    first = (const int64_t *) (header + 1);
+    heads = (const int *) (first + n + 1);
+    if(first[0] != 0 || first[n] != m)
+        return "bad offsets in graph file";
+    for(i = 0; i < n; i++)
+        if(first[i + 1] < first[i])
+            return "bad offsets in graph file";
+    for(i = 0; i < m; i++)
+        if(heads[i] < 0 || heads[i] >= n)
+            return "vertex id out of range in graph file";
+    return NULL;
+}
+
+FlowGraph GraphFile_load(const char *path, const char **error)
+{
+    const struct GraphFileHeader *header;
+    const int64_t *first;
+    const int *heads;
+    const char *data, *capacities;
+    struct stat st;
+    FlowGraph g = NULL;
+    int fd, saved;
+    int64_t n, m;
+
+    *error = NULL;
+    if((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if(fstat(fd, &st) < 0) {
+        saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    if(st.st_size < (off_t) sizeof(*header)) {
+        close(fd);
+        *error = "not a graph file";
+        return NULL;
+    }
+    data = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    saved = errno;
+    close(fd);
+    if(data == MAP_FAILED) {
+        errno = saved;
+        return NULL;
+    }
+    /* The arrays are read once from front to back. */
+    madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+
+    if(!(*error = checkFile(data, st.st_size))) {
+        header = (const struct GraphFileHeader *) data;
+        n = header->numVertices;
+        m = header->numEdges;
+        first = (const int64_t *) (header + 1);
+        heads = (const int *) (first + n + 1);
+        capacities = (const char *) heads + PAD8(m * sizeof(int));
+        g = Graph_newTyped((int) n, (int) m, (CapacityType) header->capacityType);
+        if(!g) {
+            errno = ENOMEM;
+        } else if(!Graph_setTerminals(g, header->source, header->sink)) {
+            Graph_free(g);
+            g = NULL;
+            *error = "bad graph file header";
+        } else {
+            if(!Graph_addEdgesCSR(g, (int) n, first, heads, capacities,
+                                  (CapacityType) header->capacityType)) {
+                Graph_free(g);
+                g = NULL;
+                errno = ENOMEM;
+            } else if(header->flags & GRAPHFILE_COSTS) {
+                Graph_setEdgeCosts(g, 0, (const double *) (capacities +
+                                   PAD8(m * capacitySize(header->capacityType))), (int) m);
+            }
+        }
+    }
+    munmap((void *) data, st.st_size);
+    return g;
+}
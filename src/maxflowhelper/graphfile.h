@@ -0,0 +1,48 @@
+#ifndef GRAPHFILE_INCLUDED
+#define GRAPHFILE_INCLUDED
+
+#include "flowgraph.h"
+
+/* A binary graph file holds, in native byte order:
+
+     the header below;
+     first, numVertices + 1 int64 offsets;
+     heads, numEdges int32 vertex ids, padded to a multiple of 8 bytes;
+     capacities, numEdges values of the capacity type;
+     if flags has GRAPHFILE_COSTS, padding to a multiple of 8 bytes and
+       costs, numEdges doubles.
+
+   Version 1 files never have costs.  The edges out of vertex v are
+   heads[first[v]] .. heads[first[v+1]-1].  Loading maps the file and
+   hands these arrays straight to the graph, so nothing is parsed per
+   edge. */
+
+#define GRAPHFILE_MAGIC "MAXFLOW"
+#define GRAPHFILE_VERSION 2
+#define GRAPHFILE_COSTS 1
+#define GRAPHFILE_BYTE_ORDER 0x01020304
+
+struct GraphFileHeader {
+    char magic[8];
+    uint32_t byteOrder;    /* GRAPHFILE_BYTE_ORDER as written */
+    uint32_t version;
+    uint32_t capacityType; /* A CapacityType */
+    int32_t source;
+    int32_t sink;
+    uint32_t flags;        /* 0 in version 1 files */
+    int64_t numVertices;
+    int64_t numEdges;
+};
+
+/* Writes g to path, its edges grouped by tail and otherwise in
+   insertion order, with their costs if any edge has one.  Returns 0
+   with errno set on failure. */
+int GraphFile_write(FlowGraph g, const char *path);
+
+/* Reads the graph in path, which may be of an earlier version.
+   Returns NULL on failure, with *error describing a malformed file, or
+   with *error NULL and errno set if the file could not be read or the
+   graph not allocated. */
+FlowGraph GraphFile_load(const char *path, const char **error);
+
+#endif /* GRAPHFILE_INCLUDED */
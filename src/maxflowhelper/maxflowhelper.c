@@ -1,5 +1,12 @@
 #include "Python.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include "flowgraph.h"
+#include "batch.h"
+#include "graphfile.h"
+#include "dimacs.h"
+#include "gomoryhu.h"
 
 
 static FlowGraph constructGraph(PyObject *edges, int numVertices)
@@ -7,64 +14,1546 @@ static FlowGraph constructGraph(PyObject *edges, int numVertices)
     PyObject *item, *iter;
     int numEdges = PyList_Size(edges), from, to;
     FlowGraph g = Graph_new(numVertices, numEdges);
-    float capacity;
+    double capacity;
 
+    if(!g) {
+        PyErr_NoMemory();
+        return NULL;
+    }
     iter = PyObject_GetIter(edges);
     while((item = PyIter_Next(iter))) {
         from = PyInt_AsLong(PyList_GetItem(item, 0));
         to = PyInt_AsLong(PyList_GetItem(item, 1));
-        capacity = (float) PyFloat_AsDouble(PyList_GetItem(item, 2));
-        Graph_addEdge(g, from, to, capacity);
+        capacity = PyFloat_AsDouble(PyList_GetItem(item, 2));
         Py_DECREF(item);
+        if(!Graph_addEdge(g, from, to, capacity)) {
+            Py_DECREF(iter);
+            Graph_free(g);
+            PyErr_NoMemory();
+            return NULL;
+        }
     }
     Py_DECREF(iter);
     return g;
 }
 
-static void copyFlowsToPython(FlowGraph graph, PyObject *edges)
+/* Stores the flows into the [tail, head, cap, flow] lists of edges,
+   which must be in the order the edges were added to the graph. */
+static int copyFlowsToPython(FlowGraph graph, PyObject *edges)
 {
     PyObject *item, *iter;
-    int from, to;
-    float flow;
+    int i = 0, numEdges = Graph_numEdges(graph);
+    double *flows = (double *) malloc((numEdges ? numEdges : 1) * sizeof(double));
 
-    iter = PyObject_GetIter(edges);
-    while((item = PyIter_Next(iter))) {
-        from = PyInt_AsLong(PyList_GetItem(item, 0));
-        to = PyInt_AsLong(PyList_GetItem(item, 1));
-        flow = Graph_getFlow(graph, from, to);
-        PyList_SetItem(item, 3, PyFloat_FromDouble(flow));
+    if(!flows) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    Graph_getFlows(graph, flows, CAP_DOUBLE);
+    if(!(iter = PyObject_GetIter(edges))) {
+        free(flows);
+        return 0;
+    }
+    while(i < numEdges && (item = PyIter_Next(iter))) {
+        PyList_SetItem(item, 3, PyFloat_FromDouble(flows[i++]));
         Py_DECREF(item);
     }
     Py_DECREF(iter);
+    free(flows);
+    return !PyErr_Occurred();
+}
+
+/* --------------------------------------------------------------------------- */
+/* Contiguous arrays borrowed from Python objects, either through the
+   buffer protocol (NumPy arrays, memoryviews) or, for array.array,
+   through the old-style buffer interface and its typecode.  Elements
+   are in native byte order. */
+
+struct ArrayView {
+    Py_buffer view;
+    int hasView;           /* view must be released */
+    void *copy;            /* Owned copy of the data; see pinArray() */
+    void *data;
+    Py_ssize_t length;     /* Number of elements */
+    char type;             /* 'i' for int32, 'q' for int64, 'f' for float32,
+                              'd' for float64 */
+};
+
+static char arrayType(char code, Py_ssize_t itemsize)
+{
+    if((code == 'i' || code == 'l') && itemsize == 4)
+        return 'i';
+    if((code == 'l' || code == 'q') && itemsize == 8)
+        return 'q';
+    if(code == 'f' && itemsize == 4)
+        return 'f';
+    if(code == 'd' && itemsize == 8)
+        return 'd';
+    return 0;
+}
+
+static CapacityType arrayCapacityType(char type)
+{
+    switch(type) {
+    case 'i': return CAP_INT32;
+    case 'q': return CAP_INT64;
+    case 'd': return CAP_DOUBLE;
+    default:  return CAP_FLOAT;
+    }
+}
+
+static const char *arrayTypeName(char type)
+{
+    switch(type) {
+    case 'i': return "int32";
+    case 'q': return "int64";
+    case 'f': return "float32";
+    default:  return "float64";
+    }
+}
+
+/* Borrows the contents of obj, which must be a contiguous array of one
+   of the element types in accepted; what names the argument in error
+   messages.  Returns 0 with an exception set on failure. */
+static int getArray(PyObject *obj, struct ArrayView *av, const char *accepted,
+                    int writable, const char *what)
+{
+    PyObject *typecode, *itemsize;
+    const char *format;
+    char names[64] = "";
+    Py_ssize_t bytes;
+    int ok, i, n = strlen(accepted);
+
+    av->hasView = 0;
+    av->copy = NULL;
+    av->type = 0;
+    if(PyObject_CheckBuffer(obj)) {
+        if(PyObject_GetBuffer(obj, &av->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT |
+                              (writable ? PyBUF_WRITABLE : 0)) < 0)
+            return 0;
+        av->hasView = 1;
+        av->data = av->view.buf;
+        av->length = av->view.itemsize ? av->view.len / av->view.itemsize : 0;
+        format = av->view.format ? av->view.format : "B";
+        while(*format == '@' || *format == '=' || *format == '<' ||
+              *format == '>' || *format == '!')
+            format++;
+        if(format[0] && !format[1])
+            av->type = arrayType(format[0], av->view.itemsize);
+    } else if((typecode = PyObject_GetAttrString(obj, "typecode")) &&
+              (itemsize = PyObject_GetAttrString(obj, "itemsize"))) {
+        if(PyString_Check(typecode) && PyString_Size(typecode) == 1)
+            av->type = arrayType(PyString_AsString(typecode)[0], PyInt_AsLong(itemsize));
+        Py_DECREF(typecode);
+        Py_DECREF(itemsize);
+        if(writable)
+            ok = PyObject_AsWriteBuffer(obj, &av->data, &bytes) == 0;
+        else
+            ok = PyObject_AsReadBuffer(obj, (const void **) &av->data, &bytes) == 0;
+        if(!ok)
+            return 0;
+        av->length = av->type ? bytes / (av->type == 'd' || av->type == 'q' ? 8 : 4) : 0;
+    } else {
+        Py_XDECREF(typecode);
+        PyErr_Clear();
+    }
+    if(!av->type || !strchr(accepted, av->type)) {
+        if(av->hasView)
+            PyBuffer_Release(&av->view);
+        av->hasView = 0;
+        for(i = 0; i < n; i++) {
+            if(i > 0)
+                strcat(names, i == n - 1 ? " or " : ", ");
+            strcat(names, arrayTypeName(accepted[i]));
+        }
+        PyErr_Format(PyExc_TypeError, "%s must be a contiguous %s array", what, names);
+        return 0;
+    }
+    return 1;
+}
+
+static void releaseArray(struct ArrayView *av)
+{
+    if(av->hasView)
+        PyBuffer_Release(&av->view);
+    av->hasView = 0;
+    free(av->copy);
+    av->copy = NULL;
+}
+
+/* Arrays borrowed through the old buffer interface are not held in
+   place, so another thread could resize them once the interpreter lock
+   is released.  Reads them into a copy of their own in that case.
+   Returns 0 with MemoryError set if there is no room for it. */
+static int pinArray(struct ArrayView *av)
+{
+    size_t bytes = av->length * (av->type == 'd' || av->type == 'q' ? 8 : 4);
+    if(av->hasView)
+        return 1;
+    if(!(av->copy = malloc(bytes ? bytes : 1))) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    memcpy(av->copy, av->data, bytes);
+    av->data = av->copy;
+    return 1;
+}
+
+/* --------------------------------------------------------------------------- */
+
+/* Solvers selectable by name through the algorithm argument. */
+static const struct {
+    const char *name;
+    double (*solve)(FlowGraph g);
+} solvers[] = {
+    {"edmonds_karp", Graph_maxflow},
+    {"bidirectional_edmonds_karp", Graph_maxflowBidirectional},
+    {"capacity_scaling", Graph_maxflowScaling},
+    {"push_relabel", Graph_maxflowPushRelabel},
+    {"dinic", Graph_maxflowDinic},
+    {"parallel_push_relabel", Graph_maxflowParallel},
+    {"min_cost", Graph_maxflowMinCost},
+    {NULL, NULL}
+};
+
+static double (*lookupSolver(const char *name))(FlowGraph g)
+{
+    int i;
+    for(i = 0; solvers[i].name; i++)
+        if(strcmp(solvers[i].name, name) == 0)
+            return solvers[i].solve;
+    PyErr_Format(PyExc_ValueError, "unknown max flow algorithm '%s'", name);
+    return NULL;
+}
+
+/* Capacity types selectable by name through the capacity_type argument. */
+static const struct {
+    const char *name;
+    CapacityType type;
+} capacityTypes[] = {
+    {"float32", CAP_FLOAT},
+    {"float64", CAP_DOUBLE},
+    {"int32", CAP_INT32},
+    {"int64", CAP_INT64},
+    {NULL, CAP_FLOAT}
+};
+
+static int lookupCapacityType(const char *name, CapacityType *type)
+{
+    int i;
+    for(i = 0; capacityTypes[i].name; i++) {
+        if(strcmp(capacityTypes[i].name, name) == 0) {
+            *type = capacityTypes[i].type;
+            return 1;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "unknown capacity type '%s'", name);
+    return 0;
+}
+
+/* Raises OverflowError for a capacity out of range of g's type. */
+static void capacityRangeError(CapacityType type)
+{
+    int i;
+    for(i = 0; capacityTypes[i + 1].name && capacityTypes[i].type != type; i++)
+        ;
+    PyErr_Format(PyExc_OverflowError, "capacity out of range for %s capacities",
+                 capacityTypes[i].name);
+}
+
+static int checkCapacity(FlowGraph g, double capacity)
+{
+    if(Graph_capacityFits(g, capacity))
+        return 1;
+    capacityRangeError(Graph_capacityType(g));
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    VertexOrder ordering;
+} orderings[] = {
+    {"none", ORDER_NONE},
+    {"bfs", ORDER_BFS},
+    {"rcm", ORDER_RCM},
+    {NULL, ORDER_NONE}
+};
+
+static int lookupOrdering(const char *name, VertexOrder *ordering)
+{
+    int i;
+    for(i = 0; orderings[i].name; i++) {
+        if(strcmp(orderings[i].name, name) == 0) {
+            *ordering = orderings[i].ordering;
+            return 1;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "unknown vertex ordering '%s'", name);
+    return 0;
+}
+
+/* Returns a flow value of g as a Python int for the integer capacity
+   types and as a float otherwise. */
+static PyObject *flowToPython(FlowGraph g, double value)
+{
+    CapacityType type = Graph_capacityType(g);
+    if(type != CAP_INT32 && type != CAP_INT64)
+        return PyFloat_FromDouble(value);
+    if(value >= LONG_MIN && value <= LONG_MAX)
+        return PyInt_FromLong((long) value);
+    return PyLong_FromDouble(value);
 }
 
 static PyObject *maxflow(PyObject *self, PyObject *args)
 {
     PyObject *edges;
     int numVertices;
+    const char *algorithm = "edmonds_karp";
+    double (*solve)(FlowGraph g);
     FlowGraph graph;
-    float maxflowVal;
+    double maxflowVal;
 
-    if(!PyArg_ParseTuple(args, "Oi", &edges, &numVertices))
+    if(!PyArg_ParseTuple(args, "Oi|s", &edges, &numVertices, &algorithm))
         return NULL;
     if(!PyList_Check(edges))
         return NULL;
-    graph = constructGraph(edges, numVertices);
+    if(!(solve = lookupSolver(algorithm)))
+        return NULL;
+    if(!(graph = constructGraph(edges, numVertices)))
+        return NULL;
     Py_BEGIN_ALLOW_THREADS
-    maxflowVal = Graph_maxflow(graph);
+    maxflowVal = solve(graph);
     Py_END_ALLOW_THREADS
-    copyFlowsToPython(graph, edges);
+    if(!copyFlowsToPython(graph, edges)) {
+        Graph_free(graph);
+        return NULL;
+    }
     Graph_free(graph);
-    return Py_BuildValue("f", maxflowVal);
+    return PyFloat_FromDouble(maxflowVal);
+}
+
+/* --------------------------------------------------------------------------- */
+/* maxflowhelper.CancelToken is a flag for stopping a solve from another
+   thread while the solve runs without the interpreter lock. */
+
+typedef struct {
+    PyObject_HEAD
+    int cancelled;
+} CancelToken;
+
+static PyObject *CancelToken_cancel(CancelToken *self)
+{
+    __atomic_store_n(&self->cancelled, 1, __ATOMIC_RELAXED);
+    Py_RETURN_NONE;
+}
+
+static PyObject *CancelToken_reset(CancelToken *self)
+{
+    __atomic_store_n(&self->cancelled, 0, __ATOMIC_RELAXED);
+    Py_RETURN_NONE;
+}
+
+static PyObject *CancelToken_isCancelled(CancelToken *self)
+{
+    return PyBool_FromLong(__atomic_load_n(&self->cancelled, __ATOMIC_RELAXED));
+}
+
+static PyMethodDef CancelToken_methods[] = {
+    {"cancel", (PyCFunction) CancelToken_cancel, METH_NOARGS,
+     "cancel() stops the solves given this token as soon as they next check it."},
+    {"reset", (PyCFunction) CancelToken_reset, METH_NOARGS,
+     "reset() makes the token usable for another solve."},
+    {"cancelled", (PyCFunction) CancelToken_isCancelled, METH_NOARGS,
+     "cancelled() returns whether cancel() has been called since the last reset()."},
+    {NULL, NULL, 0, NULL}  /* Sentinel (terminates structure) */
+};
+
+static PyTypeObject CancelTokenType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /* ob_size */
+    "maxflowhelper.CancelToken", /* tp_name */
+    sizeof(CancelToken),       /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    0,                         /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_compare */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "CancelToken() is passed as the cancel argument of a solve; calling its\n"
+    "cancel() from another thread stops the solve early.", /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    CancelToken_methods,       /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,                         /* tp_init */
+    0,                         /* tp_alloc */
+    PyType_GenericNew,         /* tp_new */
+};
+
+/* --------------------------------------------------------------------------- */
+/* maxflowhelper.CutTree holds a Gomory-Hu tree built by
+   Graph.gomory_hu_tree(). */
+
+typedef struct {
+    PyObject_HEAD
+    CutTree tree;
+} NativeCutTree;
+
+static void NativeCutTree_dealloc(NativeCutTree *self)
+{
+    if(self->tree)
+        CutTree_free(self->tree);
+    self->ob_type->tp_free((PyObject *) self);
+}
+
+/* Returns a new array.array of the given typecode holding size bytes. */
+static PyObject *packArray(const char *typecode, const void *data, Py_ssize_t size)
+{
+    PyObject *out, *module, *string;
+
+    if(!(string = PyString_FromStringAndSize((const char *) data, size)))
+        return NULL;
+    if(!(module = PyImport_ImportModule("array"))) {
+        Py_DECREF(string);
+        return NULL;
+    }
+    out = PyObject_CallMethod(module, "array", "sO", typecode, string);
+    Py_DECREF(module);
+    Py_DECREF(string);
+    return out;
 }
 
+static PyObject *NativeCutTree_minCut(NativeCutTree *self, PyObject *args)
+{
+    int u, v, n = CutTree_numVertices(self->tree);
+
+    if(!PyArg_ParseTuple(args, "ii", &u, &v))
+        return NULL;
+    if(u < 0 || v < 0 || u >= n || v >= n || u == v) {
+        PyErr_SetString(PyExc_ValueError, "min_cut() needs two distinct vertices of the tree");
+        return NULL;
+    }
+    return PyFloat_FromDouble(CutTree_minCut(self->tree, u, v));
+}
+
+static PyObject *NativeCutTree_parents(NativeCutTree *self)
+{
+    return packArray("i", CutTree_parents(self->tree),
+                     CutTree_numVertices(self->tree) * sizeof(int));
+}
+
+static PyObject *NativeCutTree_weights(NativeCutTree *self)
+{
+    return packArray("d", CutTree_weights(self->tree),
+                     CutTree_numVertices(self->tree) * sizeof(double));
+}
+
+static PyObject *NativeCutTree_numVertices(NativeCutTree *self)
+{
+    return PyInt_FromLong(CutTree_numVertices(self->tree));
+}
+
+static PyMethodDef NativeCutTree_methods[] = {
+    {"min_cut", (PyCFunction) NativeCutTree_minCut, METH_VARARGS,
+     "min_cut(u, v) returns the capacity of a minimum cut between vertices u\n"
+     "and v, in time logarithmic in the number of vertices."},
+    {"parents", (PyCFunction) NativeCutTree_parents, METH_NOARGS,
+     "parents() returns the parent of every vertex in the tree as an\n"
+     "array.array('i'); vertex 0 is the root, with parent -1."},
+    {"weights", (PyCFunction) NativeCutTree_weights, METH_NOARGS,
+     "weights() returns the weight of the tree edge from every vertex to its\n"
+     "parent, the minimum cut between the two, as an array.array('d')."},
+    {"num_vertices", (PyCFunction) NativeCutTree_numVertices, METH_NOARGS,
+     "num_vertices() returns the number of vertices in the tree."},
+    {NULL, NULL, 0, NULL}  /* Sentinel (terminates structure) */
+};
+
+static PyTypeObject CutTreeType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /* ob_size */
+    "maxflowhelper.CutTree",   /* tp_name */
+    sizeof(NativeCutTree),     /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor) NativeCutTree_dealloc, /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_compare */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "A Gomory-Hu tree, as returned by Graph.gomory_hu_tree().", /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    NativeCutTree_methods,     /* tp_methods */
+};
+
+/* --------------------------------------------------------------------------- */
+/* maxflowhelper.Graph keeps a native FlowGraph alive between solves, so
+   that a Python FlowGraph can update it in place instead of rebuilding
+   it from the edge list on every call. */
+
+typedef struct {
+    PyObject_HEAD
+    FlowGraph graph;
+    /* Set while a call works on the graph without the interpreter lock,
+       during which no other call may touch it. */
+    int busy;
+} NativeGraph;
+
+/* Raises RuntimeError if the graph is busy.  Checked once the arguments
+   are parsed, since parsing them can run Python code. */
+static int checkIdle(NativeGraph *self)
+{
+    if(!self->busy)
+        return 1;
+    PyErr_SetString(PyExc_RuntimeError, "graph is in use by another thread");
+    return 0;
+}
+
+static int NativeGraph_init(NativeGraph *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"numvertices", "numedges", "capacity_type",
+                             "source", "sink", "ordering", "compact", NULL};
+    int numVertices = 0, numEdges = 0, source = 0, sink = 1, compact = 0;
+    const char *typeName = "float32", *orderingName = "none";
+    CapacityType type;
+    VertexOrder ordering;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|iisiisi", kwlist,
+                                    &numVertices, &numEdges, &typeName,
+                                    &source, &sink, &orderingName, &compact))
+        return -1;
+    if(!lookupCapacityType(typeName, &type) || !lookupOrdering(orderingName, &ordering))
+        return -1;
+    if(source < 0 || sink < 0 || source == sink) {
+        PyErr_SetString(PyExc_ValueError,
+                        "source and sink must be distinct non-negative vertex ids");
+        return -1;
+    }
+    if(numEdges < 0) {
+        PyErr_SetString(PyExc_ValueError, "numedges must not be negative");
+        return -1;
+    }
+    if(!checkIdle(self))
+        return -1;
+    if(self->graph)
+        Graph_free(self->graph);
+    if(numEdges > GRAPH_MAX_HINT)
+        numEdges = GRAPH_MAX_HINT;
+    self->graph = Graph_newTyped(numVertices, numEdges, type);
+    if(!self->graph) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    Graph_setTerminals(self->graph, source, sink);
+    Graph_setOrdering(self->graph, ordering);
+    Graph_setCompact(self->graph, compact);
+    return 0;
+}
+
+static void NativeGraph_dealloc(NativeGraph *self)
+{
+    if(self->graph)
+        Graph_free(self->graph);
+    self->ob_type->tp_free((PyObject *) self);
+}
+
+static PyObject *NativeGraph_addEdge(NativeGraph *self, PyObject *args)
+{
+    int from, to;
+    double capacity, cost = 0;
+
+    if(!PyArg_ParseTuple(args, "iid|d", &from, &to, &capacity, &cost) || !checkIdle(self))
+        return NULL;
+    if(from < 0 || to < 0) {
+        PyErr_SetString(PyExc_ValueError, "vertex ids must be non-negative");
+        return NULL;
+    }
+    if(!checkCapacity(self->graph, capacity))
+        return NULL;
+    if(Graph_numEdges(self->graph) >= GRAPH_MAX_EDGES) {
+        PyErr_SetString(PyExc_OverflowError, "too many edges");
+        return NULL;
+    }
+    if(!Graph_addEdge(self->graph, from, to, capacity))
+        return PyErr_NoMemory();
+    /* Graphs without costs keep no cost array. */
+    if(cost != 0)
+        Graph_setEdgeCost(self->graph, Graph_numEdges(self->graph) - 1, cost);
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_setEdgeCost(NativeGraph *self, PyObject *args)
+{
+    int index;
+    double cost;
+
+    if(!PyArg_ParseTuple(args, "id", &index, &cost) || !checkIdle(self))
+        return NULL;
+    if(!Graph_setEdgeCost(self->graph, index, cost)) {
+        PyErr_Format(PyExc_IndexError, "there is no edge %d", index);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_getEdgeCost(NativeGraph *self, PyObject *args)
+{
+    int index;
+
+    if(!PyArg_ParseTuple(args, "i", &index) || !checkIdle(self))
+        return NULL;
+    if(index < 0 || index >= Graph_numEdges(self->graph)) {
+        PyErr_Format(PyExc_IndexError, "there is no edge %d", index);
+        return NULL;
+    }
+    return PyFloat_FromDouble(Graph_getEdgeCost(self->graph, index));
+}
+
+static PyObject *NativeGraph_flowCost(NativeGraph *self)
+{
+    if(!checkIdle(self))
+        return NULL;
+    return PyFloat_FromDouble(Graph_flowCost(self->graph));
+}
+
+static PyObject *NativeGraph_setCapacity(NativeGraph *self, PyObject *args)
+{
+    int from, to;
+    double capacity;
+
+    if(!PyArg_ParseTuple(args, "iid", &from, &to, &capacity) || !checkIdle(self) ||
+       !checkCapacity(self->graph, capacity))
+        return NULL;
+    if(!Graph_setCapacity(self->graph, from, to, capacity)) {
+        PyErr_Format(PyExc_KeyError, "there is no edge from %d to %d", from, to);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_setEdgeCapacity(NativeGraph *self, PyObject *args)
+{
+    int index;
+    double capacity;
+
+    if(!PyArg_ParseTuple(args, "id", &index, &capacity) || !checkIdle(self) ||
+       !checkCapacity(self->graph, capacity))
+        return NULL;
+    if(!Graph_setEdgeCapacity(self->graph, index, capacity)) {
+        PyErr_Format(PyExc_IndexError, "there is no edge %d", index);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/* Copies a sequence of vertex ids into a new array; None is empty. */
+static int parseIds(PyObject *obj, int **ids, int *count, const char *what)
+{
+    PyObject *seq;
+    Py_ssize_t i, size;
+    long id;
+
+    *ids = NULL;
+    *count = 0;
+    if(obj == Py_None)
+        return 1;
+    if(!(seq = PySequence_Fast(obj, "terminals must be sequences of vertex ids")))
+        return 0;
+    size = PySequence_Fast_GET_SIZE(seq);
+    if(size > INT_MAX || !(*ids = (int *) malloc((size ? size : 1) * sizeof(int)))) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return 0;
+    }
+    for(i = 0; i < size; i++) {
+        id = PyInt_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+        if(id == -1 && PyErr_Occurred())
+            break;
+        if(id < 0 || id > INT_MAX) {
+            PyErr_Format(PyExc_ValueError, "bad vertex id %ld in %s", id, what);
+            break;
+        }
+        (*ids)[i] = (int) id;
+    }
+    Py_DECREF(seq);
+    if(i < size) {
+        free(*ids);
+        *ids = NULL;
+        return 0;
+    }
+    *count = (int) size;
+    return 1;
+}
+
+static int setTerminals(NativeGraph *self, PyObject *sourcesObj, PyObject *sinksObj)
+{
+    int *sources, *sinks, numSources, numSinks, ok = 0;
+
+    if(!parseIds(sourcesObj, &sources, &numSources, "sources"))
+        return 0;
+    if(parseIds(sinksObj, &sinks, &numSinks, "sinks")) {
+        ok = Graph_setSolveTerminals(self->graph, sources, numSources, sinks, numSinks);
+        if(!ok)
+            PyErr_SetString(PyExc_ValueError,
+                            "sources and sinks must be distinct vertices of the graph");
+        free(sinks);
+    }
+    free(sources);
+    return ok;
+}
+
+static PyObject *NativeGraph_maxflow(NativeGraph *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    static char *kwlist[] = {"algorithm", "warmstart", "threads", "deadline",
+                             "max_iterations", "cancel", "reduce", "sources",
+                             "sinks", NULL};
+    const char *algorithm = "edmonds_karp";
+    int warmstart = 0, threads = 0, reduce = 0;
+    double deadline = 0;
+    long maxIterations = 0;
+    PyObject *cancelObj = Py_None, *sourcesObj = Py_None, *sinksObj = Py_None;
+    CancelToken *cancel = NULL;
+    double (*solve)(FlowGraph g);
+    double maxflowVal;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|siidlOiOO", kwlist,
+                                    &algorithm, &warmstart, &threads, &deadline,
+                                    &maxIterations, &cancelObj, &reduce,
+                                    &sourcesObj, &sinksObj))
+        return NULL;
+    if(!(solve = lookupSolver(algorithm)))
+        return NULL;
+    if(cancelObj != Py_None) {
+        if(!PyObject_TypeCheck(cancelObj, &CancelTokenType)) {
+            PyErr_SetString(PyExc_TypeError, "cancel must be a CancelToken or None");
+            return NULL;
+        }
+        cancel = (CancelToken *) cancelObj;
+    }
+    if(!checkIdle(self) || !setTerminals(self, sourcesObj, sinksObj))
+        return NULL;
+    Graph_setThreads(self->graph, threads);
+    Graph_setReduction(self->graph, reduce);
+    /* The token is only known to be alive during this call. */
+    Graph_setLimits(self->graph, deadline, maxIterations, cancel ? &cancel->cancelled : NULL);
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    if(!warmstart)
+        Graph_resetFlows(self->graph);
+    maxflowVal = solve(self->graph);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    Graph_setLimits(self->graph, 0, 0, NULL);
+    return flowToPython(self->graph, maxflowVal);
+}
+
+/* Points *values at the elements of an 'i', 'q', 'f' or 'd' array as
+   doubles: the array itself, or a copy left in *copy for the caller to
+   free.  Returns 0 if the copy cannot be allocated. */
+static int asDoubles(struct ArrayView *av, const double **values, double **copy)
+{
+    Py_ssize_t i;
+
+    *copy = NULL;
+    *values = (const double *) av->data;
+    if(av->type == 'd')
+        return 1;
+    if(!(*copy = (double *) malloc((av->length ? av->length : 1) * sizeof(double))))
+        return 0;
+    for(i = 0; i < av->length; i++) {
+        switch(av->type) {
+        case 'i': (*copy)[i] = ((int32_t *) av->data)[i]; break;
+        case 'q': (*copy)[i] = ((int64_t *) av->data)[i]; break;
+        default:  (*copy)[i] = ((float *) av->data)[i];   break;
+        }
+    }
+    *values = *copy;
+    return 1;
+}
+
+static PyObject *NativeGraph_addEdges(NativeGraph *self, PyObject *args)
+{
+    PyObject *tailsObj, *headsObj, *capsObj, *costsObj = Py_None;
+    struct ArrayView tails, heads, caps, costs;
+    const double *capacities = NULL, *costValues = NULL;
+    double *capsCopy = NULL, *costsCopy = NULL;
+    Py_ssize_t i, count;
+    int *from, *to, bad = 0, noMemory = 0, outOfRange = 0, first;
+
+    if(!PyArg_ParseTuple(args, "OOO|O", &tailsObj, &headsObj, &capsObj, &costsObj))
+        return NULL;
+    costs.hasView = 0;
+    costs.copy = NULL;
+    if(!getArray(tailsObj, &tails, "i", 0, "tails"))
+        return NULL;
+    if(!getArray(headsObj, &heads, "i", 0, "heads")) {
+        releaseArray(&tails);
+        return NULL;
+    }
+    if(!getArray(capsObj, &caps, "iqfd", 0, "caps")) {
+        releaseArray(&tails);
+        releaseArray(&heads);
+        return NULL;
+    }
+    if(costsObj != Py_None && !getArray(costsObj, &costs, "iqfd", 0, "costs"))
+        goto done;
+    count = tails.length;
+    from = (int *) tails.data;
+    to = (int *) heads.data;
+    if(heads.length != count || caps.length != count ||
+       (costsObj != Py_None && costs.length != count)) {
+        PyErr_SetString(PyExc_ValueError, "tails, heads, caps and costs must have the same length");
+        goto done;
+    }
+    if(!checkIdle(self))
+        goto done;
+    if(count > GRAPH_MAX_EDGES - Graph_numEdges(self->graph)) {
+        PyErr_SetString(PyExc_OverflowError, "too many edges");
+        goto done;
+    }
+    if(!pinArray(&tails) || !pinArray(&heads) || !pinArray(&caps) ||
+       (costsObj != Py_None && !pinArray(&costs)))
+        goto done;
+    from = (int *) tails.data;
+    to = (int *) heads.data;
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    for(i = 0; i < count; i++)
+        if(from[i] < 0 || to[i] < 0)
+            bad = 1;
+    if(!bad) {
+        if(!asDoubles(&caps, &capacities, &capsCopy) ||
+           (costsObj != Py_None && !asDoubles(&costs, &costValues, &costsCopy)))
+            noMemory = 1;
+        for(i = 0; !noMemory && !outOfRange && i < count; i++)
+            outOfRange = !Graph_capacityFits(self->graph, capacities[i]);
+        if(!noMemory && !outOfRange) {
+            first = Graph_numEdges(self->graph);
+            if(!Graph_addEdges(self->graph, from, to, capacities, (int) count))
+                noMemory = 1;
+            else if(costsObj != Py_None)
+                Graph_setEdgeCosts(self->graph, first, costValues, (int) count);
+        }
+        free(capsCopy);
+        free(costsCopy);
+    }
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    if(bad)
+        PyErr_SetString(PyExc_ValueError, "vertex ids must be non-negative");
+    else if(noMemory)
+        PyErr_NoMemory();
+    else if(outOfRange)
+        capacityRangeError(Graph_capacityType(self->graph));
+
+done:
+    releaseArray(&tails);
+    releaseArray(&heads);
+    releaseArray(&caps);
+    releaseArray(&costs);
+    if(PyErr_Occurred())
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_getFlows(NativeGraph *self, PyObject *args)
+{
+    PyObject *out = NULL, *module, *string;
+    struct ArrayView flows;
+    int numEdges;
+    CapacityType type;
+    const char *typecode;
+    size_t itemsize;
+
+    if(!PyArg_ParseTuple(args, "|O", &out))
+        return NULL;
+    if(out && out != Py_None) {
+        /* Write straight into the caller's array. */
+        if(!getArray(out, &flows, "iqfd", 1, "out"))
+            return NULL;
+        if(!checkIdle(self)) {
+            releaseArray(&flows);
+            return NULL;
+        }
+        if(flows.length < Graph_numEdges(self->graph)) {
+            releaseArray(&flows);
+            PyErr_SetString(PyExc_ValueError, "out is shorter than the number of edges");
+            return NULL;
+        }
+        Graph_getFlows(self->graph, flows.data, arrayCapacityType(flows.type));
+        releaseArray(&flows);
+        Py_INCREF(out);
+        return out;
+    }
+
+    /* Otherwise pack the flows into a new array.array of the graph's
+       capacity type; int64 needs an 8-byte long, or falls back to
+       float64. */
+    if(!checkIdle(self))
+        return NULL;
+    numEdges = Graph_numEdges(self->graph);
+    type = Graph_capacityType(self->graph);
+    switch(type) {
+    case CAP_INT32:  typecode = "i"; itemsize = sizeof(int32_t); break;
+    case CAP_DOUBLE: typecode = "d"; itemsize = sizeof(double);  break;
+    case CAP_FLOAT:  typecode = "f"; itemsize = sizeof(float);   break;
+    default:
+        if(sizeof(long) == sizeof(int64_t)) {
+            typecode = "l";
+            itemsize = sizeof(int64_t);
+        } else {
+            type = CAP_DOUBLE;
+            typecode = "d";
+            itemsize = sizeof(double);
+        }
+    }
+    string = PyString_FromStringAndSize(NULL, numEdges * itemsize);
+    if(!string)
+        return NULL;
+    Graph_getFlows(self->graph, PyString_AS_STRING(string), type);
+    if(!(module = PyImport_ImportModule("array"))) {
+        Py_DECREF(string);
+        return NULL;
+    }
+    out = PyObject_CallMethod(module, "array", "sO", typecode, string);
+    Py_DECREF(module);
+    Py_DECREF(string);
+    return out;
+}
+
+static PyObject *NativeGraph_getFlow(NativeGraph *self, PyObject *args)
+{
+    int from, to;
+
+    if(!PyArg_ParseTuple(args, "ii", &from, &to) || !checkIdle(self))
+        return NULL;
+    return flowToPython(self->graph, Graph_getFlow(self->graph, from, to));
+}
+
+static PyObject *NativeGraph_numVertices(NativeGraph *self)
+{
+    if(!checkIdle(self))
+        return NULL;
+    return PyInt_FromLong(Graph_numVertices(self->graph));
+}
+
+static PyObject *NativeGraph_numEdges(NativeGraph *self)
+{
+    if(!checkIdle(self))
+        return NULL;
+    return PyInt_FromLong(Graph_numEdges(self->graph));
+}
+
+static PyObject *NativeGraph_minCut(NativeGraph *self)
+{
+    PyObject *out, *module, *string;
+    int count;
+
+    if(!checkIdle(self))
+        return NULL;
+    string = PyString_FromStringAndSize(NULL, Graph_numVertices(self->graph) * sizeof(int));
+    if(!string)
+        return NULL;
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    count = Graph_minCut(self->graph, (int *) PyString_AS_STRING(string));
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    if(_PyString_Resize(&string, count * sizeof(int)) < 0)
+        return NULL;
+    if(!(module = PyImport_ImportModule("array"))) {
+        Py_DECREF(string);
+        return NULL;
+    }
+    out = PyObject_CallMethod(module, "array", "sO", "i", string);
+    Py_DECREF(module);
+    Py_DECREF(string);
+    return out;
+}
+
+static PyObject *NativeGraph_gomoryHuTree(NativeGraph *self, PyObject *args,
+                                          PyObject *kwds)
+{
+    static char *kwlist[] = {"algorithm", "threads", NULL};
+    const char *algorithm = "edmonds_karp";
+    int threads = 1;
+    double (*solve)(FlowGraph g);
+    NativeCutTree *out;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|si", kwlist, &algorithm, &threads))
+        return NULL;
+    if(!(solve = lookupSolver(algorithm)) || !checkIdle(self))
+        return NULL;
+    if(!(out = PyObject_New(NativeCutTree, &CutTreeType)))
+        return NULL;
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    out->tree = CutTree_build(self->graph, solve, threads);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    if(!out->tree) {
+        Py_DECREF(out);
+        return PyErr_NoMemory();
+    }
+    return (PyObject *) out;
+}
+
+static PyObject *NativeGraph_terminals(NativeGraph *self)
+{
+    int source, sink;
+    if(!checkIdle(self))
+        return NULL;
+    Graph_getTerminals(self->graph, &source, &sink);
+    return Py_BuildValue("ii", source, sink);
+}
+
+static PyObject *NativeGraph_setOrdering(NativeGraph *self, PyObject *args)
+{
+    const char *name;
+    VertexOrder ordering;
+
+    if(!PyArg_ParseTuple(args, "s", &name))
+        return NULL;
+    if(!lookupOrdering(name, &ordering) || !checkIdle(self))
+        return NULL;
+    Graph_setOrdering(self->graph, ordering);
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_setCompact(NativeGraph *self, PyObject *args)
+{
+    PyObject *value;
+    int compact;
+
+    if(!PyArg_ParseTuple(args, "O", &value))
+        return NULL;
+    if((compact = PyObject_IsTrue(value)) < 0 || !checkIdle(self))
+        return NULL;
+    Graph_setCompact(self->graph, compact);
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_stats(NativeGraph *self)
+{
+    const struct SolveStats *s = Graph_stats(self->graph);
+    if(!checkIdle(self))
+        return NULL;
+    return Py_BuildValue("{s:l,s:l,s:l,s:l,s:l,s:l,s:l,s:l,s:l,s:N,s:l,s:l,s:l,s:l,s:l,s:l,s:d,s:d}",
+                         "augmentations", s->augmentations,
+                         "vertices_scanned", s->verticesScanned,
+                         "arcs_scanned", s->arcsScanned,
+                         "pushes", s->pushes,
+                         "relabels", s->relabels,
+                         "global_relabels", s->globalRelabels,
+                         "gaps", s->gaps,
+                         "phases", s->phases,
+                         "iterations", s->iterations,
+                         "optimal", PyBool_FromLong(s->optimal),
+                         "arcs", s->arcs,
+                         "reverse_arcs", s->reverseArcs,
+                         "peak_bytes", s->peakBytes,
+                         "edge_bytes", s->edgeBytes,
+                         "reduced_vertices", s->reducedVertices,
+                         "reduced_edges", s->reducedEdges,
+                         "build_seconds", s->buildSeconds,
+                         "solve_seconds", s->solveSeconds);
+}
+
+static PyObject *NativeGraph_optimal(NativeGraph *self)
+{
+    if(!checkIdle(self))
+        return NULL;
+    return PyBool_FromLong(Graph_stats(self->graph)->optimal);
+}
+
+static PyObject *NativeGraph_save(NativeGraph *self, PyObject *args)
+{
+    const char *path;
+    int ok;
+
+    if(!PyArg_ParseTuple(args, "s", &path) || !checkIdle(self))
+        return NULL;
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    ok = GraphFile_write(self->graph, path);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    if(!ok)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *) path);
+    Py_RETURN_NONE;
+}
+
+static PyObject *NativeGraph_copyFlows(NativeGraph *self, PyObject *args)
+{
+    PyObject *edges;
+
+    if(!PyArg_ParseTuple(args, "O", &edges) || !checkIdle(self))
+        return NULL;
+    if(!copyFlowsToPython(self->graph, edges))
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef NativeGraph_methods[] = {
+    {"add_edge", (PyCFunction) NativeGraph_addEdge, METH_VARARGS,
+     "add_edge(tail, head, cap[, cost]) adds an edge between two vertex ids,\n"
+     "with the given cost per unit of flow for the 'min_cost' solver.  A\n"
+     "capacity outside the range of the capacity type raises OverflowError."},
+    {"set_edge_cost", (PyCFunction) NativeGraph_setEdgeCost, METH_VARARGS,
+     "set_edge_cost(index, cost) changes the cost of the edge with the given\n"
+     "index in insertion order."},
+    {"get_edge_cost", (PyCFunction) NativeGraph_getEdgeCost, METH_VARARGS,
+     "get_edge_cost(index) returns the cost of the edge with the given index."},
+    {"flow_cost", (PyCFunction) NativeGraph_flowCost, METH_NOARGS,
+     "flow_cost() returns the total cost of the current flow."},
+    {"set_capacity", (PyCFunction) NativeGraph_setCapacity, METH_VARARGS,
+     "set_capacity(tail, head, cap) changes the capacity of an existing edge,\n"
+     "keeping the current flow feasible.  Of parallel edges, the first one\n"
+     "added is changed."},
+    {"set_edge_capacity", (PyCFunction) NativeGraph_setEdgeCapacity, METH_VARARGS,
+     "set_edge_capacity(index, cap) is set_capacity() for the edge with the\n"
+     "given index in insertion order."},
+    {"maxflow", (PyCFunction) NativeGraph_maxflow, METH_VARARGS | METH_KEYWORDS,
+     "maxflow([algorithm, warmstart, threads]) returns the max flow.  The solve\n"
+     "starts from zero flow unless warmstart is true, in which case it continues\n"
+     "from the flow left by the last solve and capacity changes since.  threads\n"
+     "is used by 'parallel_push_relabel' and defaults to one per processor.\n"
+     "deadline (seconds), max_iterations and cancel (a CancelToken) bound the\n"
+     "solve; one that reaches a bound returns a feasible flow that may not be\n"
+     "maximum, and optimal() tells which.  If reduce is true, the solve runs on a\n"
+     "copy without the edges no flow can use, with parallel edges merged and\n"
+     "chains contracted, from zero flow.  sources and sinks are sequences of\n"
+     "vertex ids to solve between instead of the source and sink, as if a\n"
+     "source fed every vertex in sources and every vertex in sinks drained into\n"
+     "a sink; min_cut() then returns the side of the sources.  The terminals\n"
+     "stay in force for get_flows() and min_cut() until the next solve."},
+    {"add_edges", (PyCFunction) NativeGraph_addEdges, METH_VARARGS,
+     "add_edges(tails, heads, caps[, costs]) adds many edges at once from\n"
+     "contiguous int32 id arrays and int32, int64, float32 or float64 capacity\n"
+     "and cost arrays, using the buffer protocol (NumPy arrays, array.array,\n"
+     "memoryviews).  If any capacity is outside the range of the capacity\n"
+     "type, or the graph would pass 2**29 - 1 edges, none of the edges are\n"
+     "added and OverflowError is raised."},
+    {"get_flows", (PyCFunction) NativeGraph_getFlows, METH_VARARGS,
+     "get_flows([out]) returns the flows in edge insertion order as an\n"
+     "array.array of the graph's capacity type, or writes them into out,\n"
+     "an int32, int64, float32 or float64 array."},
+    {"get_flow", (PyCFunction) NativeGraph_getFlow, METH_VARARGS,
+     "get_flow(tail, head) returns the flow on an edge, summed over parallel\n"
+     "edges, or 0.0 if there is none."},
+    {"num_vertices", (PyCFunction) NativeGraph_numVertices, METH_NOARGS,
+     "num_vertices() returns one more than the highest vertex id, counting\n"
+     "the source and sink."},
+    {"num_edges", (PyCFunction) NativeGraph_numEdges, METH_NOARGS,
+     "num_edges() returns the number of edges."},
+    {"min_cut", (PyCFunction) NativeGraph_minCut, METH_NOARGS,
+     "min_cut() returns the ids of the vertices on the source side of a minimum\n"
+     "cut as an array.array('i'), in increasing order.  These are the vertices\n"
+     "reachable from the source in the residual graph of the current flow, so\n"
+     "call it after a solve."},
+    {"terminals", (PyCFunction) NativeGraph_terminals, METH_NOARGS,
+     "terminals() returns the (source, sink) vertex ids."},
+    {"set_ordering", (PyCFunction) NativeGraph_setOrdering, METH_VARARGS,
+     "set_ordering(ordering) selects how the solvers number the vertices: 'none'\n"
+     "keeps the ids, 'bfs' numbers them breadth-first from the source and\n"
+     "'rcm' in reverse Cuthill-McKee order, which keeps neighbours close in\n"
+     "memory.  Vertex ids seen from Python do not change."},
+    {"set_compact", (PyCFunction) NativeGraph_setCompact, METH_VARARGS,
+     "set_compact(compact) with a true value keeps the edges of a solved graph\n"
+     "in nothing but its residual arcs, about 14 bytes an arc with 32-bit\n"
+     "capacities, and puts their own arrays back only when adding edges,\n"
+     "listing or saving them, looking one up by its ends or changing the\n"
+     "ordering or terminals needs them.  Capacities put back are those of the\n"
+     "capacity type."},
+    {"stats", (PyCFunction) NativeGraph_stats, METH_NOARGS,
+     "stats() returns a dict of counters and timings for the last solve:\n"
+     "augmentations, vertices_scanned and arcs_scanned by searches, pushes,\n"
+     "relabels, global_relabels, gaps, phases, the residual arcs and the\n"
+     "reverse_arcs built for the solve, peak_bytes of the residual graph,\n"
+     "edge_bytes held by the edges outside it, and build_seconds and\n"
+     "solve_seconds, along with the iterations counted\n"
+     "against max_iterations and whether the flow is optimal."},
+    {"optimal", (PyCFunction) NativeGraph_optimal, METH_NOARGS,
+     "optimal() returns False if a limit stopped the last solve before the flow\n"
+     "was maximum."},
+    {"save", (PyCFunction) NativeGraph_save, METH_VARARGS,
+     "save(path) writes the graph to a binary file for load_graph(), with the\n"
+     "edges grouped by tail and their costs kept."},
+    {"copy_flows", (PyCFunction) NativeGraph_copyFlows, METH_VARARGS,
+     "copy_flows(edges) stores the flows into [tail, head, cap, flow] lists,\n"
+     "given in the order the edges were added."},
+    {"gomory_hu_tree", (PyCFunction) NativeGraph_gomoryHuTree, METH_VARARGS | METH_KEYWORDS,
+     "gomory_hu_tree([algorithm, threads]) returns a CutTree giving the minimum\n"
+     "cut between every pair of vertices, with the edges taken as undirected.\n"
+     "It solves one max flow per vertex with the given algorithm on a copy of\n"
+     "the graph, leaving the graph and its flows alone.  With threads other\n"
+     "than 1 (0 for one per processor), that many copies solve cuts at once;\n"
+     "cuts found against an outdated tree are solved again."},
+    {NULL, NULL, 0, NULL}  /* Sentinel (terminates structure) */
+};
+
+static PyTypeObject NativeGraphType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /* ob_size */
+    "maxflowhelper.Graph",     /* tp_name */
+    sizeof(NativeGraph),       /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor) NativeGraph_dealloc, /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_compare */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "Graph([numvertices, numedges, capacity_type, source, sink, ordering,\n"
+    "compact]) is a\n"
+    "native flow graph over integer vertex ids, kept between solves.\n"
+    "capacity_type is 'float32' (the default), 'float64', 'int32' or 'int64';\n"
+    "integer graphs solve exactly and return int flows.  source and sink are\n"
+    "the ids of the terminals, 0 and 1 by default, and ordering and compact\n"
+    "are as for set_ordering() and set_compact().", /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    NativeGraph_methods,       /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc) NativeGraph_init, /* tp_init */
+    0,                         /* tp_alloc */
+    PyType_GenericNew,         /* tp_new */
+};
+
+/* --------------------------------------------------------------------------- */
+/* maxflow_batch solves many independent graphs on native threads.  All
+   Python objects are read before the interpreter lock is released and
+   written after it is taken back, so the threads only see C data. */
+
+/* Copies a [[tail, head, cap, flow], ...] list into one block holding
+   the job's edge arrays and room for its flows.  The job solves it as
+   a float32 graph, whose range the capacities must be in. */
+static int parseEdgeList(PyObject *edges, struct BatchJob *job)
+{
+    PyObject *item;
+    Py_ssize_t numEdges = PyList_GET_SIZE(edges), i;
+    char *block;
+    int *from, *to;
+    double *capacity;
+
+    if(numEdges > GRAPH_MAX_EDGES) {
+        PyErr_SetString(PyExc_OverflowError, "too many edges");
+        return 0;
+    }
+    block = (char *) malloc((numEdges ? numEdges : 1) *
+                            (2 * sizeof(int) + 2 * sizeof(double)));
+    if(!block) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    from = (int *) block;
+    to = from + numEdges;
+    capacity = (double *) (to + numEdges);
+    for(i = 0; i < numEdges; i++) {
+        item = PyList_GET_ITEM(edges, i);
+        if(!PyList_Check(item) || PyList_GET_SIZE(item) < 4) {
+            PyErr_SetString(PyExc_TypeError, "edges must be [tail, head, cap, flow] lists");
+            break;
+        }
+        from[i] = PyInt_AsLong(PyList_GET_ITEM(item, 0));
+        to[i] = PyInt_AsLong(PyList_GET_ITEM(item, 1));
+        capacity[i] = PyFloat_AsDouble(PyList_GET_ITEM(item, 2));
+        if(PyErr_Occurred())
+            break;
+        if(from[i] < 0 || to[i] < 0) {
+            PyErr_SetString(PyExc_ValueError, "vertex ids must be non-negative");
+            break;
+        }
+        if(!Graph_capacityFitsType(CAP_FLOAT, capacity[i])) {
+            capacityRangeError(CAP_FLOAT);
+            break;
+        }
+    }
+    if(i < numEdges) {
+        free(block);
+        return 0;
+    }
+    job->graph = NULL;
+    job->from = from;
+    job->to = to;
+    job->capacity = capacity;
+    job->count = (int) numEdges;
+    job->flows = capacity + numEdges;
+    return 1;
+}
+
+static int comparePointers(const void *a, const void *b)
+{
+    const char *x = *(const char **) a, *y = *(const char **) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Refuses batches that would solve the same Graph on two threads. */
+static int distinctGraphs(struct BatchJob *jobs, int numJobs)
+{
+    FlowGraph *graphs = (FlowGraph *) malloc((numJobs > 0 ? numJobs : 1) * sizeof(FlowGraph));
+    int i, n = 0, ok = 1;
+
+    if(!graphs) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    for(i = 0; i < numJobs; i++)
+        if(jobs[i].graph)
+            graphs[n++] = jobs[i].graph;
+    qsort(graphs, n, sizeof(FlowGraph), comparePointers);
+    for(i = 1; i < n; i++)
+        if(graphs[i] == graphs[i - 1])
+            ok = 0;
+    free(graphs);
+    if(!ok)
+        PyErr_SetString(PyExc_ValueError, "a Graph appears more than once in the batch");
+    return ok;
+}
+
+/* Marks the Graphs among the items of a batch busy, or idle again. */
+static void setBusy(PyObject *seq, struct BatchJob *jobs, int numJobs, int busy)
+{
+    int i;
+    for(i = 0; i < numJobs; i++)
+        if(jobs[i].graph)
+            ((NativeGraph *) PyTuple_GET_ITEM(seq, i))->busy = busy;
+}
+
+/* Wraps a graph read from path in a new maxflowhelper.Graph; a NULL
+   graph failed with error, or errno if error is NULL. */
+static PyObject *wrapGraph(FlowGraph graph, const char *path, const char *error,
+                           long line)
+{
+    NativeGraph *result;
+
+    if(!graph) {
+        if(error && line > 0)
+            PyErr_Format(PyExc_ValueError, "%s:%ld: %s", path, line, error);
+        else if(error)
+            PyErr_Format(PyExc_ValueError, "%s: %s", path, error);
+        else if(errno == ENOMEM)
+            PyErr_NoMemory();
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *) path);
+        return NULL;
+    }
+    if(!(result = (NativeGraph *) NativeGraphType.tp_alloc(&NativeGraphType, 0))) {
+        Graph_free(graph);
+        return NULL;
+    }
+    result->graph = graph;
+    return (PyObject *) result;
+}
+
+static PyObject *loadGraph(PyObject *self, PyObject *args)
+{
+    const char *path, *error;
+    FlowGraph graph;
+
+    if(!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    graph = GraphFile_load(path, &error);
+    Py_END_ALLOW_THREADS
+    return wrapGraph(graph, path, error, 0);
+}
+
+static PyObject *readDimacs(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"path", "capacity_type", NULL};
+    const char *path, *typeName = "float32", *error;
+    CapacityType type;
+    FlowGraph graph;
+    long line;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "s|s", kwlist, &path, &typeName))
+        return NULL;
+    if(!lookupCapacityType(typeName, &type))
+        return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    graph = Dimacs_read(path, type, &error, &line);
+    Py_END_ALLOW_THREADS
+    return wrapGraph(graph, path, error, line);
+}
+
+static PyObject *maxflowBatch(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"graphs", "threads", "algorithm", "warmstart", NULL};
+    PyObject *graphs, *seq, *item, *edge, *results = NULL;
+    const char *algorithm = "edmonds_karp";
+    int threads = 0, warmstart = 0, i, j, numJobs, parsed = 0;
+    double (*solve)(FlowGraph g);
+    struct BatchJob *jobs;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|isi", kwlist, &graphs,
+                                    &threads, &algorithm, &warmstart))
+        return NULL;
+    if(!(solve = lookupSolver(algorithm)))
+        return NULL;
+    /* The tuple copy keeps every instance alive while the lock is released. */
+    if(!(seq = PySequence_Tuple(graphs)))
+        return NULL;
+    if(PyTuple_GET_SIZE(seq) > INT_MAX) {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_OverflowError, "too many graphs");
+        return NULL;
+    }
+    numJobs = (int) PyTuple_GET_SIZE(seq);
+    jobs = (struct BatchJob *) calloc(numJobs ? numJobs : 1, sizeof(struct BatchJob));
+    if(!jobs) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    for(i = 0; i < numJobs; i++, parsed++) {
+        item = PyTuple_GET_ITEM(seq, i);
+        jobs[i].warmstart = warmstart;
+        if(PyObject_TypeCheck(item, &NativeGraphType)) {
+            jobs[i].graph = ((NativeGraph *) item)->graph;
+        } else if(PyList_Check(item)) {
+            if(!parseEdgeList(item, jobs + i))
+                goto done;
+        } else {
+            PyErr_SetString(PyExc_TypeError,
+                            "graphs must be maxflowhelper.Graph objects or edge lists");
+            goto done;
+        }
+    }
+    if(!distinctGraphs(jobs, numJobs))
+        goto done;
+    for(i = 0; i < numJobs; i++) {
+        item = PyTuple_GET_ITEM(seq, i);
+        if(jobs[i].graph && !checkIdle((NativeGraph *) item))
+            goto done;
+    }
+
+    setBusy(seq, jobs, numJobs, 1);
+    Py_BEGIN_ALLOW_THREADS
+    Batch_run(jobs, numJobs, solve, threads);
+    Py_END_ALLOW_THREADS
+    setBusy(seq, jobs, numJobs, 0);
+
+    if(!(results = PyList_New(numJobs)))
+        goto done;
+    for(i = 0; i < numJobs; i++) {
+        item = PyTuple_GET_ITEM(seq, i);
+        /* Other threads may have changed the lists in the meantime. */
+        for(j = 0; !jobs[i].graph && j < jobs[i].count && j < PyList_GET_SIZE(item); j++) {
+            edge = PyList_GET_ITEM(item, j);
+            if(PyList_Check(edge) && PyList_GET_SIZE(edge) >= 4)
+                PyList_SetItem(edge, 3, PyFloat_FromDouble(jobs[i].flows[j]));
+        }
+        PyList_SET_ITEM(results, i, jobs[i].graph ?
+                        flowToPython(jobs[i].graph, jobs[i].maxflow) :
+                        PyFloat_FromDouble(jobs[i].maxflow));
+    }
+
+done:
+    for(i = 0; i < parsed; i++)
+        if(!jobs[i].graph)
+            free((void *) jobs[i].from);
+    free(jobs);
+    Py_DECREF(seq);
+    return results;
+}
+
+/* --------------------------------------------------------------------------- */
+
 static PyMethodDef maxflowMethods[] = {
     {"maxflow",  maxflow, METH_VARARGS,
-     "Finds the max flow of the input graph."},
+     "Finds the max flow of the input graph.  The optional third argument\n"
+     "selects the algorithm: 'edmonds_karp' (the default),\n"
+     "'bidirectional_edmonds_karp', 'capacity_scaling', 'push_relabel',\n"
+     "'dinic', 'parallel_push_relabel' or 'min_cost'."},
+    {"load_graph", loadGraph, METH_VARARGS,
+     "load_graph(path) maps a binary graph file written by Graph.save() and\n"
+     "returns it as a new Graph, without parsing the edges one by one."},
+    {"read_dimacs", (PyCFunction) readDimacs, METH_VARARGS | METH_KEYWORDS,
+     "read_dimacs(path[, capacity_type]) reads a DIMACS max flow problem\n"
+     "('p max', 'n' and 'a' lines) into a new Graph.  Vertices keep their ids\n"
+     "from the file, and the source and sink are the ones the file names."},
+    {"maxflow_batch", (PyCFunction) maxflowBatch, METH_VARARGS | METH_KEYWORDS,
+     "maxflow_batch(graphs[, threads, algorithm, warmstart]) solves many\n"
+     "independent instances on native threads and returns their max flows\n"
+     "in order.  Each instance is a maxflowhelper.Graph, solved in place,\n"
+     "or an edge list as for maxflow(), whose flows are filled in.  threads\n"
+     "defaults to one per processor.  A capacity in an edge list outside the\n"
+     "float32 range raises OverflowError, and nothing is solved."},
     {NULL, NULL, 0, NULL}  /* Sentinel (terminates structure) */
 };
 
 PyMODINIT_FUNC initmaxflowhelper(void)
 {
-    Py_InitModule("maxflowhelper", maxflowMethods);
+    PyObject *module;
+
+    if(PyType_Ready(&NativeGraphType) < 0 || PyType_Ready(&CancelTokenType) < 0 ||
+       PyType_Ready(&CutTreeType) < 0)
+        return;
+    module = Py_InitModule("maxflowhelper", maxflowMethods);
+    if(!module)
+        return;
+    Py_INCREF(&NativeGraphType);
+    PyModule_AddObject(module, "Graph", (PyObject *) &NativeGraphType);
+    Py_INCREF(&CancelTokenType);
+    PyModule_AddObject(module, "CancelToken", (PyObject *) &CancelTokenType);
+    Py_INCREF(&CutTreeType);
+    PyModule_AddObject(module, "CutTree", (PyObject *) &CutTreeType);
 }
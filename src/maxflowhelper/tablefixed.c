@@ -1,6 +1,6 @@
 #include "tablefixed.h"
 #include <stdlib.h>
-#include <limits.h>
+#include <string.h>
 #include <assert.h>
 
 
@@ -9,42 +9,49 @@
 /***************************************************************************/
 
 
+/* the table doubles whenever more than MAX_LOAD_NUM / MAX_LOAD_DEN of its
+   slots are in use, which keeps linear probe sequences short */
+#define MIN_SLOTS    16
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 10
+
 struct TableFixed {
   unsigned long ulNumBindings;
   size_t uiKeySize;
-  unsigned long ulNumBuckets;
+  unsigned long ulNumSlots;   /* always a power of two */
   int (*compare)(const void *, const void *, size_t);
   unsigned long (*hash)(const void *, size_t);
-  struct Node **ppnArray;
-};
-
-struct Node {
-  const void *pvKey;
-  void *pvValue;
-  struct Node *next;
+  char *pcKeys;               /* ulNumSlots keys of uiKeySize bytes each */
+  void **ppvValues;           /* value of each slot; NULL if it is empty */
 };
 
 struct TableFixedIter {
-  unsigned long ulCurrentBucket;
+  unsigned long ulCurrentSlot;
   struct TableFixed *oTableFixed;
-  struct Node *pnCurrentNode;
+  int iValid;
 };
 
-typedef struct Node *Node_L;
-
 
 /***************************************************************************/
 /*                      Local function declarations                        */
 /***************************************************************************/
 
 
-static Node_L getNode(TableFixed_T oTableFixed, const void *pvKey);
-/* returns a pointer to the node with key pvKey, or NULL if there is no
-   such node */
+static long findSlot(TableFixed_T oTableFixed, const void *pvKey);
+/* returns the index of the slot holding key pvKey, or -1 if there is no
+   such slot */
+
+static unsigned long calculateSlots(unsigned long ulEstLength);
+/* returns the number of slots that will be used in the hash table based on
+   the estimated length */
 
-static unsigned long calculateBuckets(unsigned long ulEstLength);
-/* returns the number of buckets that will be used in the hash table
-   based on the estimated length */
+static void resize(TableFixed_T oTableFixed, unsigned long ulNumSlots);
+/* moves every binding of oTableFixed into a new array of ulNumSlots slots */
+
+static void insert(TableFixed_T oTableFixed, const void *pvKey,
+		   void *pvValue);
+/* stores the binding in the first free slot of pvKey's probe sequence.
+   pvKey must not already be in the table, which must have a free slot */
 
 /* the following hash functions hash the key and return the hash code. hash8,
    hash 12, and hash16 are optimized for keys of the respective size */
@@ -53,6 +60,9 @@ static unsigned long hash8(const void *pvKey, size_t uiKeySize);
 static unsigned long hash12(const void *pvKey, size_t uiKeySize);
 static unsigned long hash16(const void *pvKey, size_t uiKeySize);
 
+static unsigned long long mix64(unsigned long long ullKey);
+/* returns ullKey with every bit spread over the whole word */
+
 /* the following compare functions return 0 if the two keys are equal, and
    1 otherwise. compare8, compare12, and compare16 are optimized for keys
    of the respective sizes */
@@ -62,6 +72,10 @@ static int compare8(const void *pvKey1, const void *pvKey2, size_t uiKeySize);
 static int compare12(const void *pvKey1, const void *pvKey2, size_t uiKeySize);
 static int compare16(const void *pvKey1, const void *pvKey2, size_t uiKeySize);
 
+/* returns a pointer to the key stored in slot ulSlot */
+#define SLOT_KEY(oTableFixed, ulSlot) \
+  ((oTableFixed)->pcKeys + (ulSlot) * (oTableFixed)->uiKeySize)
+
 
 /***************************************************************************/
 /*                      TableFixed implementation                          */
@@ -71,7 +85,8 @@ static int compare16(const void *pvKey1, const void *pvKey2, size_t uiKeySize);
 TableFixed_T TableFixed_new(unsigned long ulEstLength, size_t uiKeySize)
 
 /* returns a new TableFixed_T. ulEstLength is an estimated max length of
-   the table, and each key must contain uiKeySize bytes */
+   the table, and each key must contain uiKeySize bytes. the table grows as
+   needed, so the estimate only saves resizing */
 
 {
   TableFixed_T oTableFixed;
@@ -82,11 +97,11 @@ TableFixed_T TableFixed_new(unsigned long ulEstLength, size_t uiKeySize)
   /* initialize the fields */
   oTableFixed->ulNumBindings = 0;
   oTableFixed->uiKeySize = uiKeySize;
-  oTableFixed->ulNumBuckets = calculateBuckets(ulEstLength);
+  oTableFixed->ulNumSlots = calculateSlots(ulEstLength);
 
   /* "install" the appropriate compare and hash functions */
   switch(uiKeySize) {
-  case 8: 
+  case 8:
     oTableFixed->compare = compare8;
     oTableFixed->hash = hash8;
     break;
@@ -103,10 +118,12 @@ TableFixed_T TableFixed_new(unsigned long ulEstLength, size_t uiKeySize)
     oTableFixed->hash = hashGeneric;
   }
 
-  /* allocate memory for the array of pointers to bindings (nodes) */
-  oTableFixed->ppnArray = (Node_L *) calloc(oTableFixed->ulNumBuckets,
-					    sizeof(*oTableFixed->ppnArray));
-  assert(oTableFixed->ppnArray != NULL);
+  /* allocate the slots, all initially empty */
+  oTableFixed->pcKeys = (char *) malloc(oTableFixed->ulNumSlots * uiKeySize);
+  oTableFixed->ppvValues = (void **) calloc(oTableFixed->ulNumSlots,
+					    sizeof(*oTableFixed->ppvValues));
+  assert(oTableFixed->pcKeys != NULL);
+  assert(oTableFixed->ppvValues != NULL);
 
   return oTableFixed;
 }
@@ -117,22 +134,10 @@ void TableFixed_free(TableFixed_T oTableFixed)
 /* frees all memory associated with oTableFixed */
 
 {
-  int i;
-  Node_L pn1, pn2;
-
   assert(oTableFixed != NULL);
 
-  /* free the linked lists of bindings (nodes) */
-  for(i = 0; i < oTableFixed->ulNumBuckets; i++) {
-    pn1 = oTableFixed->ppnArray[i];
-    while(pn1 != NULL) {
-      pn2 = pn1->next;
-      free(pn1);
-      pn1 = pn2;
-    }
-  }
-
-  free(oTableFixed->ppnArray);
+  free(oTableFixed->pcKeys);
+  free(oTableFixed->ppvValues);
   free(oTableFixed);
 }
 
@@ -151,35 +156,23 @@ int TableFixed_put(TableFixed_T oTableFixed, const void *pvKey, void *pvValue)
 
 /* adds a binding to oTableFixed with the specified pvKey and pvValue and
    returns 1 if successful. rejects bindings with duplicate keys and returns
-   0 */
+   0. the key is copied into the table, so pvKey need not stay valid */
 
 {
-  unsigned long ulHashCode;
-  Node_L *ppnNode;
-  Node_L pnNewNode;
-
   assert(oTableFixed != NULL);
   assert(pvKey != NULL);
   assert(pvValue != NULL);
 
   /* return 0 if pvKey already exists in oTableFixed */
-  if(getNode(oTableFixed, pvKey) != NULL)
+  if(findSlot(oTableFixed, pvKey) >= 0)
     return 0;
 
-  /* find appropriate bucket */
-  ulHashCode = (*oTableFixed->hash)(pvKey, oTableFixed->uiKeySize);
-  ppnNode = oTableFixed->ppnArray + (ulHashCode % oTableFixed->ulNumBuckets);
-
-  /* create new node */
-  pnNewNode = (Node_L) malloc(sizeof(*pnNewNode));
-  assert(pnNewNode != NULL);
-  pnNewNode->pvKey = pvKey;
-  pnNewNode->pvValue = pvValue;
- 
-  /* link new node into list */
-  pnNewNode->next = *ppnNode;
-  *ppnNode = pnNewNode;
+  /* grow before the table gets too full */
+  if((oTableFixed->ulNumBindings + 1) * MAX_LOAD_DEN >
+     oTableFixed->ulNumSlots * MAX_LOAD_NUM)
+    resize(oTableFixed, 2 * oTableFixed->ulNumSlots);
 
+  insert(oTableFixed, pvKey, pvValue);
   oTableFixed->ulNumBindings++;
 
   return 1;
@@ -192,33 +185,34 @@ void *TableFixed_getValue(TableFixed_T oTableFixed, const void *pvKey)
    if no such binding exists */
 
 {
-  Node_L pnNode;
+  long lSlot;
 
   assert(oTableFixed != NULL);
   assert(pvKey);
-  
-  pnNode = getNode(oTableFixed, pvKey);
-  if(pnNode == NULL)
+
+  lSlot = findSlot(oTableFixed, pvKey);
+  if(lSlot < 0)
     return NULL;
-  return pnNode->pvValue;
+  return oTableFixed->ppvValues[lSlot];
 }
 
 
 const void *TableFixed_getKey(TableFixed_T oTableFixed, const void *pvKey)
 
-/* returns a pointer to the key of the binding with key pvKey. returns NULL
-   if no such binding exists */
+/* returns a pointer to the table's copy of the key of the binding with key
+   pvKey, valid until the table is next changed. returns NULL if no such
+   binding exists */
 
 {
-  Node_L pnNode;
+  long lSlot;
 
   assert(oTableFixed != NULL);
   assert(pvKey != NULL);
-  
-  pnNode = getNode(oTableFixed, pvKey);
-  if(pnNode == NULL)
+
+  lSlot = findSlot(oTableFixed, pvKey);
+  if(lSlot < 0)
     return NULL;
-  return pnNode->pvKey;
+  return SLOT_KEY(oTableFixed, lSlot);
 }
 
 
@@ -228,45 +222,38 @@ int TableFixed_remove(TableFixed_T oTableFixed, const void *pvKey)
    successful and 0 otherwise (such as if no such key exists) */
 
 {
-  Node_L pnNode, pnNodeBefore;
-  Node_L *ppnArray;
+  unsigned long ulHole, ulSlot, ulHome, ulMask;
   size_t uiKeySize;
-  unsigned long ulHashCode;
+  long lSlot;
 
   assert(oTableFixed != NULL);
   assert(pvKey != NULL);
 
-  ppnArray = oTableFixed->ppnArray;
-  uiKeySize = oTableFixed->uiKeySize;
-  ulHashCode = (*oTableFixed->hash)(pvKey, uiKeySize);
-  pnNodeBefore = ppnArray[ulHashCode % oTableFixed->ulNumBuckets];
-
-  /* check if bucket is empty */
-  if(pnNodeBefore == NULL)
+  lSlot = findSlot(oTableFixed, pvKey);
+  if(lSlot < 0)
     return 0;
 
-  /* check if first node of list is to be removed */
-  if((*oTableFixed->compare)(pvKey, pnNodeBefore->pvKey, uiKeySize) == 0) {
-    ppnArray[ulHashCode % oTableFixed->ulNumBuckets] = pnNodeBefore->next;
-    free(pnNodeBefore);
-  }
-
-  else {
-    /* make pnNodeBefore point to node before the node to be removed */
-    while(pnNodeBefore->next != NULL &&
-	  (*oTableFixed->compare)(pvKey, pnNodeBefore->next->pvKey,
-				  oTableFixed->uiKeySize) == 1)
-      pnNodeBefore = pnNodeBefore->next;
-
-    /* check if key is not in table */
-    if(pnNodeBefore->next == NULL)
-      return 0;
-
-    /* remove binding */
-    pnNode = pnNodeBefore->next;
-    pnNodeBefore->next = pnNode->next;
-    free(pnNode);
+  /* shift later members of the probe run back into the hole, so that no
+     tombstones are needed: a binding may fill the hole if the hole lies
+     between its home slot and its current slot */
+  ulMask = oTableFixed->ulNumSlots - 1;
+  uiKeySize = oTableFixed->uiKeySize;
+  ulHole = (unsigned long) lSlot;
+  ulSlot = ulHole;
+  while(1) {
+    ulSlot = (ulSlot + 1) & ulMask;
+    if(oTableFixed->ppvValues[ulSlot] == NULL)
+      break;
+    ulHome = (*oTableFixed->hash)(SLOT_KEY(oTableFixed, ulSlot), uiKeySize)
+      & ulMask;
+    if(((ulSlot - ulHome) & ulMask) >= ((ulSlot - ulHole) & ulMask)) {
+      memcpy(SLOT_KEY(oTableFixed, ulHole), SLOT_KEY(oTableFixed, ulSlot),
+	     uiKeySize);
+      oTableFixed->ppvValues[ulHole] = oTableFixed->ppvValues[ulSlot];
+      ulHole = ulSlot;
+    }
   }
+  oTableFixed->ppvValues[ulHole] = NULL;
 
   oTableFixed->ulNumBindings--;
 
@@ -282,7 +269,6 @@ void TableFixed_toArrays(TableFixed_T oTableFixed, const void **ppvKeyArray,
    the bindings (at least TableFixed_length() elements) */
 
 {
-  Node_L pnNode;
   unsigned long i, ulLength;
   unsigned long ulPosition;
 
@@ -290,15 +276,13 @@ void TableFixed_toArrays(TableFixed_T oTableFixed, const void **ppvKeyArray,
   assert(ppvKeyArray != NULL);
   assert(ppvValueArray != NULL);
 
-  ulLength = oTableFixed->ulNumBuckets;
+  ulLength = oTableFixed->ulNumSlots;
 
   ulPosition = 0;
   for(i = 0; i < ulLength; i++) {
-    pnNode = oTableFixed->ppnArray[i];
-    while(pnNode != NULL) {
-      ppvKeyArray[ulPosition] = pnNode->pvKey;
-      ppvValueArray[ulPosition++] = pnNode->pvValue;
-      pnNode = pnNode->next;
+    if(oTableFixed->ppvValues[i] != NULL) {
+      ppvKeyArray[ulPosition] = SLOT_KEY(oTableFixed, i);
+      ppvValueArray[ulPosition++] = oTableFixed->ppvValues[i];
     }
   }
 }
@@ -312,21 +296,17 @@ void TableFixed_map(TableFixed_T oTableFixed,
 /* applies function *pfApply to each binding in oTableFixed */
 
 {
-  Node_L pnNode;
   unsigned long i, ulLength;
 
   assert(oTableFixed != NULL);
   assert(pfApply != NULL);
 
-  ulLength = oTableFixed->ulNumBuckets;
+  ulLength = oTableFixed->ulNumSlots;
 
-  for(i = 0; i < ulLength; i++) {
-    pnNode = oTableFixed->ppnArray[i];
-    while(pnNode != NULL) {
-      (*pfApply)(pnNode->pvKey, &pnNode->pvValue, pvExtra);
-      pnNode = pnNode->next;
-    }
-  }
+  for(i = 0; i < ulLength; i++)
+    if(oTableFixed->ppvValues[i] != NULL)
+      (*pfApply)(SLOT_KEY(oTableFixed, i), &oTableFixed->ppvValues[i],
+		 pvExtra);
 }
 
 
@@ -336,85 +316,147 @@ void TableFixed_map(TableFixed_T oTableFixed,
 /***************************************************************************/
 
 
-static Node_L getNode(TableFixed_T oTableFixed, const void *pvKey)
+static long findSlot(TableFixed_T oTableFixed, const void *pvKey)
 
-/* returns a pointer to the node with key pvKey, or NULL if there is no
-   such node */
+/* returns the index of the slot holding key pvKey, or -1 if there is no
+   such slot */
 
 {
   size_t uiKeySize;
-  unsigned long ulHashCode;
-  Node_L pnNode;
+  unsigned long ulSlot, ulMask;
 
   assert(oTableFixed != NULL);
   assert(pvKey != NULL);
 
-  /* find appropriate bucket */
+  /* probe from the home slot until the key or an empty slot turns up */
   uiKeySize = oTableFixed->uiKeySize;
-  ulHashCode = (*oTableFixed->hash)(pvKey, uiKeySize);
-  pnNode = oTableFixed->ppnArray[ulHashCode % oTableFixed->ulNumBuckets];
+  ulMask = oTableFixed->ulNumSlots - 1;
+  ulSlot = (*oTableFixed->hash)(pvKey, uiKeySize) & ulMask;
+  while(oTableFixed->ppvValues[ulSlot] != NULL) {
+    if((*oTableFixed->compare)(pvKey, SLOT_KEY(oTableFixed, ulSlot),
+			       uiKeySize) == 0)
+      return (long) ulSlot;
+    ulSlot = (ulSlot + 1) & ulMask;
+  }
+
+  return -1;
+}
+
+
+static unsigned long calculateSlots(unsigned long ulEstLength)
+
+/* returns the number of slots that will be used in the hash table based on
+   the estimated length */
+
+{
+  unsigned long ulNumSlots = MIN_SLOTS;
+
+  /* leave room for ulEstLength bindings below the maximum load */
+  while(ulNumSlots * MAX_LOAD_NUM < ulEstLength * MAX_LOAD_DEN)
+    ulNumSlots *= 2;
+  return ulNumSlots;
+}
+
+
+static void resize(TableFixed_T oTableFixed, unsigned long ulNumSlots)
 
-  /* find node in bucket (keep pnNode NULL if it does not exist) */
-  while(pnNode != NULL &&
-	(*oTableFixed->compare)(pvKey, pnNode->pvKey, uiKeySize) == 1)
-    pnNode = pnNode->next;
+/* moves every binding of oTableFixed into a new array of ulNumSlots slots */
 
-  return pnNode;
+{
+  char *pcOldKeys;
+  void **ppvOldValues;
+  unsigned long i, ulOldSlots;
+
+  assert(oTableFixed != NULL);
+
+  pcOldKeys = oTableFixed->pcKeys;
+  ppvOldValues = oTableFixed->ppvValues;
+  ulOldSlots = oTableFixed->ulNumSlots;
+
+  oTableFixed->ulNumSlots = ulNumSlots;
+  oTableFixed->pcKeys = (char *) malloc(ulNumSlots * oTableFixed->uiKeySize);
+  oTableFixed->ppvValues = (void **) calloc(ulNumSlots,
+					    sizeof(*oTableFixed->ppvValues));
+  assert(oTableFixed->pcKeys != NULL);
+  assert(oTableFixed->ppvValues != NULL);
+
+  for(i = 0; i < ulOldSlots; i++)
+    if(ppvOldValues[i] != NULL)
+      insert(oTableFixed, pcOldKeys + i * oTableFixed->uiKeySize,
+	     ppvOldValues[i]);
+
+  free(pcOldKeys);
+  free(ppvOldValues);
 }
 
 
-static unsigned long calculateBuckets(unsigned long ulEstLength)
+static void insert(TableFixed_T oTableFixed, const void *pvKey,
+		   void *pvValue)
 
-/* returns the number of buckets that will be used in the hash table
-   based on the estimated length */
+/* stores the binding in the first free slot of pvKey's probe sequence.
+   pvKey must not already be in the table, which must have a free slot */
 
 {
-  /* this code taken from Hanson book */
-
-  int i;
-  static unsigned long primes[] = { 509, 509, 1021, 2053, 4093, 8191, 16381,
-				    32771, 65521, 130003, 260003, 520019,
-				    1040021, 2080003, 4160003, 8320001,
-				    16000057, 32000011, 64000031, 128000003,
-				    256000001, 512000009, 1000000007,
-				    1999999973, ULONG_MAX };
-
-  for(i = 1; primes[i] < ulEstLength; i++);
-  return primes[i - 1];
+  unsigned long ulSlot, ulMask;
+
+  ulMask = oTableFixed->ulNumSlots - 1;
+  ulSlot = (*oTableFixed->hash)(pvKey, oTableFixed->uiKeySize) & ulMask;
+  while(oTableFixed->ppvValues[ulSlot] != NULL)
+    ulSlot = (ulSlot + 1) & ulMask;
+
+  memcpy(SLOT_KEY(oTableFixed, ulSlot), pvKey, oTableFixed->uiKeySize);
+  oTableFixed->ppvValues[ulSlot] = pvValue;
+}
+
+
+static unsigned long long mix64(unsigned long long ullKey)
+
+/* returns ullKey with every bit spread over the whole word (the final
+   mixing step of MurmurHash3), so that its low bits make a good slot
+   index */
+
+{
+  ullKey ^= ullKey >> 33;
+  ullKey *= 0xff51afd7ed558ccdULL;
+  ullKey ^= ullKey >> 33;
+  ullKey *= 0xc4ceb9fe1a85ec53ULL;
+  ullKey ^= ullKey >> 33;
+  return ullKey;
 }
 
 
 static unsigned long hashGeneric(const void *pvKey, size_t uiKeySize)
 
-/* hashes pvKey (returns the sum of its bytes) */
+/* hashes pvKey (64-bit FNV-1a over its bytes) */
 
 {
-  unsigned long ulHashCode = 0;
-  char *pcKey = (char *) pvKey;
+  unsigned long long ullHashCode = 0xcbf29ce484222325ULL;
+  unsigned char *pucKey = (unsigned char *) pvKey;
   size_t i;
 
   assert(pvKey != NULL);
 
-  for(i = 0; i < uiKeySize; i++)
-    ulHashCode += (unsigned long) pcKey[i];
+  for(i = 0; i < uiKeySize; i++) {
+    ullHashCode ^= pucKey[i];
+    ullHashCode *= 0x100000001b3ULL;
+  }
 
-  return ulHashCode;
+  return (unsigned long) mix64(ullHashCode);
 }
 
 
 static unsigned long hash8(const void *pvKey, size_t uiKeySize)
 
-/* same as hashGeneric, but optimized for keys 8 bytes long */
+/* same as hashGeneric, but optimized for keys 8 bytes long: the key is
+   mixed as a single 64-bit word */
 
 {
-  char *pcKey = (char *) pvKey;
+  unsigned long long ullKey;
 
   assert(pvKey != NULL);
 
-  return (unsigned long) pcKey[0] + (unsigned long) pcKey[1] +
-    (unsigned long) pcKey[2] + (unsigned long) pcKey[3] +
-    (unsigned long) pcKey[4] + (unsigned long) pcKey[5] +
-    (unsigned long) pcKey[6] + (unsigned long) pcKey[7];
+  memcpy(&ullKey, pvKey, 8);
+  return (unsigned long) mix64(ullKey);
 }
 
 
@@ -423,16 +465,14 @@ static unsigned long hash12(const void *pvKey, size_t uiKeySize)
 /* same as hashGeneric, but optimized for keys 12 bytes long */
 
 {
-  char *pcKey = (char *) pvKey;
+  unsigned long long ullKey;
+  unsigned int uiLast;
 
   assert(pvKey != NULL);
 
-  return (unsigned long) pcKey[0] + (unsigned long) pcKey[1] +
-    (unsigned long) pcKey[2] + (unsigned long) pcKey[3] +
-    (unsigned long) pcKey[4] + (unsigned long) pcKey[5] +
-    (unsigned long) pcKey[6] + (unsigned long) pcKey[7] +
-    (unsigned long) pcKey[8] + (unsigned long) pcKey[9] +
-    (unsigned long) pcKey[10] + (unsigned long) pcKey[11];
+  memcpy(&ullKey, pvKey, 8);
+  memcpy(&uiLast, (const char *) pvKey + 8, 4);
+  return (unsigned long) mix64(mix64(ullKey) ^ uiLast);
 }
 
 
@@ -441,18 +481,13 @@ static unsigned long hash16(const void *pvKey, size_t uiKeySize)
 /* same as hashGeneric, but optimized for keys 16 bytes long */
 
 {
-  char *pcKey = (char *) pvKey;
+  unsigned long long ullKey1, ullKey2;
 
   assert(pvKey != NULL);
 
-  return (unsigned long) pcKey[0] + (unsigned long) pcKey[1] +
-    (unsigned long) pcKey[2] + (unsigned long) pcKey[3] +
-    (unsigned long) pcKey[4] + (unsigned long) pcKey[5] +
-    (unsigned long) pcKey[6] + (unsigned long) pcKey[7] +
-    (unsigned long) pcKey[8] + (unsigned long) pcKey[9] +
-    (unsigned long) pcKey[10] + (unsigned long) pcKey[11] +
-    (unsigned long) pcKey[12] + (unsigned long) pcKey[13] +
-    (unsigned long) pcKey[14] + (unsigned long) pcKey[15];
+  memcpy(&ullKey1, pvKey, 8);
+  memcpy(&ullKey2, (const char *) pvKey + 8, 8);
+  return (unsigned long) mix64(mix64(ullKey1) ^ ullKey2);
 }
 
 
@@ -462,35 +497,27 @@ static int compareGeneric(const void *pvKey1, const void *pvKey2,
 /* returns 0 if pvKey1 and pvKey2 are equal, 1 otherwise */
 
 {
-  char *pcKey1 = (char *) pvKey1, *pcKey2 = (char *) pvKey2;
-  size_t i;
-
   assert(pvKey1 != NULL);
   assert(pvKey2 != NULL);
 
-  for(i = 0; i < uiKeySize; i++)
-    if(pcKey1[i] != pcKey2[i])
-      return 1;
-  return 0;
+  return memcmp(pvKey1, pvKey2, uiKeySize) != 0;
 }
 
 
 static int compare8(const void *pvKey1, const void *pvKey2, size_t uiKeySize)
 
-/* same as compareGeneric but optimized for keys 8 bytes long */
+/* same as compareGeneric but optimized for keys 8 bytes long: the keys are
+   compared as single 64-bit words */
 
 {
-  char *pcKey1 = (char *) pvKey1, *pcKey2 = (char *) pvKey2;
+  unsigned long long ullKey1, ullKey2;
 
   assert(pvKey1 != NULL);
   assert(pvKey2 != NULL);
 
-  if(pcKey1[0] == pcKey2[0] && pcKey1[1] == pcKey2[1] &&
-     pcKey1[2] == pcKey2[2] && pcKey1[3] == pcKey2[3] &&
-     pcKey1[4] == pcKey2[4] && pcKey1[5] == pcKey2[5] &&
-     pcKey1[6] == pcKey2[6] && pcKey1[7] == pcKey2[7])
-    return 0;
-  return 1;
+  memcpy(&ullKey1, pvKey1, 8);
+  memcpy(&ullKey2, pvKey2, 8);
+  return ullKey1 != ullKey2;
 }
 
 
@@ -499,19 +526,17 @@ static int compare12(const void *pvKey1, const void *pvKey2, size_t uiKeySize)
 /* same as compareGeneric but optimized for keys 12 bytes long */
 
 {
-  char *pcKey1 = (char *) pvKey1, *pcKey2 = (char *) pvKey2;
+  unsigned long long ullKey1, ullKey2;
+  unsigned int uiLast1, uiLast2;
 
   assert(pvKey1 != NULL);
   assert(pvKey2 != NULL);
 
-  if(pcKey1[0] == pcKey2[0] && pcKey1[1] == pcKey2[1] &&
-     pcKey1[2] == pcKey2[2] && pcKey1[3] == pcKey2[3] &&
-     pcKey1[4] == pcKey2[4] && pcKey1[5] == pcKey2[5] &&
-     pcKey1[6] == pcKey2[6] && pcKey1[7] == pcKey2[7] &&
-     pcKey1[8] == pcKey2[8] && pcKey1[9] == pcKey2[9] &&
-     pcKey1[10] == pcKey2[10] && pcKey1[11] == pcKey2[11])
-    return 0;
-  return 1;
+  memcpy(&ullKey1, pvKey1, 8);
+  memcpy(&ullKey2, pvKey2, 8);
+  memcpy(&uiLast1, (const char *) pvKey1 + 8, 4);
+  memcpy(&uiLast2, (const char *) pvKey2 + 8, 4);
+  return ullKey1 != ullKey2 || uiLast1 != uiLast2;
 }
 
 
@@ -520,21 +545,16 @@ static int compare16(const void *pvKey1, const void *pvKey2, size_t uiKeySize)
 /* same as compareGeneric but optimized for keys 16 bytes long */
 
 {
-  char *pcKey1 = (char *) pvKey1, *pcKey2 = (char *) pvKey2;
+  unsigned long long ullKey1, ullKey2, ullKey3, ullKey4;
 
   assert(pvKey1 != NULL);
   assert(pvKey2 != NULL);
 
-  if(pcKey1[0] == pcKey2[0] && pcKey1[1] == pcKey2[1] &&
-     pcKey1[2] == pcKey2[2] && pcKey1[3] == pcKey2[3] &&
-     pcKey1[4] == pcKey2[4] && pcKey1[5] == pcKey2[5] &&
-     pcKey1[6] == pcKey2[6] && pcKey1[7] == pcKey2[7] &&
-     pcKey1[8] == pcKey2[8] && pcKey1[9] == pcKey2[9] &&
-     pcKey1[10] == pcKey2[10] && pcKey1[11] == pcKey2[11] &&
-     pcKey1[12] == pcKey2[12] && pcKey1[13] == pcKey2[13] &&
-     pcKey1[14] == pcKey2[14] && pcKey1[15] == pcKey2[15])
-    return 0;
-  return 1;
+  memcpy(&ullKey1, pvKey1, 8);
+  memcpy(&ullKey2, pvKey2, 8);
+  memcpy(&ullKey3, (const char *) pvKey1 + 8, 8);
+  memcpy(&ullKey4, (const char *) pvKey2 + 8, 8);
+  return ullKey1 != ullKey2 || ullKey3 != ullKey4;
 }
 
 
@@ -557,9 +577,9 @@ TableFixedIter_T TableFixedIter_new(TableFixed_T oTableFixed)
   assert(oTableFixedIter != NULL);
 
   /* initialize fields */
-  oTableFixedIter->ulCurrentBucket = 0;
+  oTableFixedIter->ulCurrentSlot = 0;
   oTableFixedIter->oTableFixed = oTableFixed;
-  oTableFixedIter->pnCurrentNode = NULL;
+  oTableFixedIter->iValid = 0;
 
   return oTableFixedIter;
 }
@@ -581,9 +601,7 @@ int TableFixedIter_valid(TableFixedIter_T oTableFixedIter)
 
 {
   assert(oTableFixedIter != NULL);
-  if(oTableFixedIter->pnCurrentNode == NULL)
-    return 0;
-  return 1;
+  return oTableFixedIter->iValid;
 }
 
 
@@ -593,23 +611,11 @@ void TableFixedIter_selectFirst(TableFixedIter_T oTableFixedIter)
    to a valid state if and only if the table contains at least one binding */
 
 {
-  unsigned long i, ulLength;
-  TableFixed_T oTableFixed;
-
   assert(oTableFixedIter != NULL);
 
-  oTableFixed = oTableFixedIter->oTableFixed;
-  ulLength = oTableFixed->ulNumBuckets;
-  oTableFixedIter->pnCurrentNode = NULL;
-
-  /* loop through buckets until a non-NULL one is found */
-  for(i = 0; i < ulLength; i++) {
-    if(oTableFixed->ppnArray[i] != NULL) {
-      oTableFixedIter->pnCurrentNode = oTableFixed->ppnArray[i];
-      oTableFixedIter->ulCurrentBucket = i;
-      return;
-    }
-  }
+  oTableFixedIter->ulCurrentSlot = (unsigned long) -1;
+  oTableFixedIter->iValid = 1;
+  TableFixedIter_selectNext(oTableFixedIter);
 }
 
 
@@ -623,29 +629,21 @@ void TableFixedIter_selectNext(TableFixedIter_T oTableFixedIter)
   TableFixed_T oTableFixed;
 
   assert(oTableFixedIter != NULL);
-  assert(oTableFixedIter->pnCurrentNode != NULL);
+  assert(oTableFixedIter->iValid);
 
   oTableFixed = oTableFixedIter->oTableFixed;
+  ulLength = oTableFixed->ulNumSlots;
 
-  /* if the next binding is in the same bucket */
-  if(oTableFixedIter->pnCurrentNode->next != NULL) {
-    oTableFixedIter->pnCurrentNode = oTableFixedIter->pnCurrentNode->next;
-    return;
-  }
-
-  ulLength = oTableFixed->ulNumBuckets;
-
-  /* otherwise, step through buckets until find a binding */
-  for(i = oTableFixedIter->ulCurrentBucket + 1; i < ulLength; i++) {
-    if(oTableFixed->ppnArray[i] != NULL) {
-      oTableFixedIter->pnCurrentNode = oTableFixed->ppnArray[i];
-      oTableFixedIter->ulCurrentBucket = i;
+  /* step through the slots until a binding turns up */
+  for(i = oTableFixedIter->ulCurrentSlot + 1; i < ulLength; i++) {
+    if(oTableFixed->ppvValues[i] != NULL) {
+      oTableFixedIter->ulCurrentSlot = i;
       return;
     }
   }
 
   /* if there are no bindings, state becomes invalid */
-  oTableFixedIter->pnCurrentNode = NULL;
+  oTableFixedIter->iValid = 0;
 }
 
 
@@ -655,8 +653,9 @@ const void *TableFixedIter_selectedKey(TableFixedIter_T oTableFixedIter)
 
 {
   assert(oTableFixedIter != NULL);
-  assert(oTableFixedIter->pnCurrentNode != NULL);
-  return oTableFixedIter->pnCurrentNode->pvKey;
+  assert(oTableFixedIter->iValid);
+  return SLOT_KEY(oTableFixedIter->oTableFixed,
+		  oTableFixedIter->ulCurrentSlot);
 }
 
 
@@ -666,6 +665,7 @@ void *TableFixedIter_selectedValue(TableFixedIter_T oTableFixedIter)
 
 {
   assert(oTableFixedIter != NULL);
-  assert(oTableFixedIter->pnCurrentNode != NULL);
-  return oTableFixedIter->pnCurrentNode->pvValue;
+  assert(oTableFixedIter->iValid);
+  return oTableFixedIter->oTableFixed->ppvValues
+    [oTableFixedIter->ulCurrentSlot];
 }
@@ -15,7 +15,8 @@ typedef struct TableFixedIter *TableFixedIter_T;
 
 TableFixed_T TableFixed_new(unsigned long ulEstLength, size_t uiKeySize);
 /* returns a new TableFixed_T. ulEstLength is an estimated max length of
-   the table, and each key must contain uiKeySize bytes */
+   the table, and each key must contain uiKeySize bytes. the table grows as
+   needed, so the estimate only saves resizing */
 
 void TableFixed_free(TableFixed_T oTableFixed);
 /* frees all memory associated with oTableFixed */
@@ -26,15 +27,16 @@ unsigned long TableFixed_length(TableFixed_T oTableFixed);
 int TableFixed_put(TableFixed_T oTableFixed, const void *pvKey, void *pvValue);
 /* adds a binding to oTableFixed with the specified pvKey and pvValue and
    returns 1 if successful. rejects bindings with duplicate keys and returns
-   0 */
+   0. the key is copied into the table, so pvKey need not stay valid */
 
 void *TableFixed_getValue(TableFixed_T oTableFixed, const void *pvKey);
 /* returns a pointer to the value of the binding with key pvKey. returns NULL
    if no such binding exists */
 
 const void *TableFixed_getKey(TableFixed_T oTableFixed, const void *pvKey);
-/* returns a pointer to the key of the binding with key pvKey. returns NULL
-   if no such binding exists */
+/* returns a pointer to the table's copy of the key of the binding with key
+   pvKey, valid until the table is next changed. returns NULL if no such
+   binding exists */
 
 int TableFixed_remove(TableFixed_T oTableFixed, const void *pvKey);
 /* removes binding from oTableFixed with a key of pvKey. returns 1 if
@@ -0,0 +1,18 @@
+# maxflow_batch.  See test_terminals.py for how to run these.
+
+import unittest
+from maxflow import maxflowhelper
+
+
+class BatchTest(unittest.TestCase):
+    def test_capacity_out_of_range(self):
+        g = maxflowhelper.Graph()
+        g.add_edge(0, 1, 2.0)
+        self.assertRaises(OverflowError, maxflowhelper.maxflow_batch,
+                          [g, [[0, 1, 1e40, 0.0]]])
+        self.assertEqual(g.get_flows().tolist(), [0.0])
+        self.assertEqual(maxflowhelper.maxflow_batch([[[0, 1, 3.0, 0.0]]]), [3.0])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,38 @@
+# DIMACS max flow files.  See test_terminals.py for how to run these.
+
+import os
+import shutil
+import tempfile
+import unittest
+from maxflow import maxflowhelper
+
+
+class DimacsTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, 'graph.max')
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def read(self, problem):
+        with open(self.path, 'w') as f:
+            f.write(problem + '\nn 1 s\nn 2 t\na 1 2 5\n')
+        return maxflowhelper.read_dimacs(self.path)
+
+    def assertBad(self, problem, message):
+        with self.assertRaises(ValueError) as cm:
+            self.read(problem)
+        self.assertTrue(message in str(cm.exception), str(cm.exception))
+
+    def test_arc_count_is_a_hint(self):
+        self.assertEqual(self.read('p max 2 1').maxflow(), 5.0)
+        self.assertBad('p max 2 100000000', 'fewer arcs than the problem line says')
+        self.assertBad('p max 2 2147483647', 'too many arcs')
+
+    def test_problem_line(self):
+        self.assertBad('p max3 1', 'not a max flow problem')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,44 @@
+# Gomory-Hu trees.  See test_terminals.py for how to run these.
+
+import random
+import unittest
+from maxflow import DenseFlowGraph
+
+
+def randomgraph(rng, n):
+    g = DenseFlowGraph(0, 1)
+    edges = []
+    for v in range(1, n):
+        edges.append((rng.randrange(v), v, rng.randint(1, 9)))
+    for i in range(2 * n):
+        u, v = rng.sample(range(n), 2)
+        edges.append((u, v, rng.randint(1, 9)))
+    for u, v, cap in edges:
+        g.addedge(u, v, cap)
+    return g, edges
+
+
+class GomoryHuTest(unittest.TestCase):
+    def test_tree_edges_are_cuts(self):
+        rng = random.Random(27)
+        for trial in range(50):
+            n = rng.randint(2, 12)
+            g, edges = randomgraph(rng, n)
+            for threads in (1, 3):
+                tree = g.gomoryhutree('push_relabel', threads=threads)
+                parents, weights = tree.parents(), tree.weights()
+                for v in range(1, n):
+                    # The side of v once its tree edge is removed.
+                    side = set(u for u in range(n) if self.below(parents, u, v))
+                    crossing = sum(cap for a, b, cap in edges if (a in side) != (b in side))
+                    self.assertEqual(crossing, weights[v])
+                    self.assertEqual(tree.min_cut(v, parents[v]), weights[v])
+
+    def below(self, parents, u, v):
+        while u != v and u >= 0:
+            u = parents[u]
+        return u == v
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,18 @@
+# Building native graphs.  See test_terminals.py for how to run these.
+
+import unittest
+from maxflow import maxflowhelper
+
+
+class GraphTest(unittest.TestCase):
+    def test_edge_count_is_a_hint(self):
+        g = maxflowhelper.Graph(0, 2000000000)
+        g.add_edge(0, 1, 3.0)
+        self.assertEqual(g.maxflow(), 3.0)
+
+    def test_negative_edge_count(self):
+        self.assertRaises(ValueError, maxflowhelper.Graph, 0, -1)
+
+
+if __name__ == '__main__':
+    unittest.main()
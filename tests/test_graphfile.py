@@ -0,0 +1,54 @@
+# Binary graph files.  See test_terminals.py for how to run these.
+
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+from maxflow import DenseFlowGraph
+
+
+class GraphFileTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, 'graph.bin')
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def test_costs_round_trip(self):
+        # Three 4-byte capacities, so the costs follow padding.
+        for capacity_type in ('int32', 'float64'):
+            g = DenseFlowGraph(0, 1, capacity_type=capacity_type)
+            g.addedge(0, 2, 4, cost=1)
+            g.addedge(2, 1, 4, cost=1)
+            g.addedge(0, 1, 4, cost=5)
+            g.save(self.path)
+            loaded = DenseFlowGraph.load(self.path)
+            self.assertEqual(loaded.calculatemaxflow('min_cost'), 8)
+            self.assertEqual(loaded.flowcost(), 28)
+
+    def write(self, version, source, sink, heads):
+        # Three vertices, with an edge out of vertex 0 and one out of 2.
+        header = struct.pack('=8sIIIiiIqq', b'MAXFLOW', 0x01020304, version, 2,
+                             source, sink, 0, 3, 2)
+        with open(self.path, 'wb') as f:
+            f.write(header + struct.pack('=4q', 0, 1, 1, 2) + struct.pack('=2i', *heads) +
+                    struct.pack('=2i', 3, 7))
+
+    def test_version_1(self):
+        self.write(1, 0, 1, (2, 1))
+        self.assertEqual(DenseFlowGraph.load(self.path).calculatemaxflow(), 3)
+
+    def test_out_of_range(self):
+        for source, sink, heads, message in ((0, 1, (2, 3), 'vertex id out of range'),
+                                             (0, 3, (2, 1), 'bad graph file header'),
+                                             (5, 1, (2, 1), 'bad graph file header')):
+            self.write(2, source, sink, heads)
+            with self.assertRaises(ValueError) as cm:
+                DenseFlowGraph.load(self.path)
+            self.assertTrue(message in str(cm.exception), str(cm.exception))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,29 @@
+# Bounded solves.  See test_terminals.py for how to run these.
+
+import unittest
+from maxflow import DenseFlowGraph
+
+ALGORITHMS = ['edmonds_karp', 'bidirectional_edmonds_karp', 'capacity_scaling',
+              'push_relabel', 'dinic', 'min_cost']
+
+
+class LimitTest(unittest.TestCase):
+    def test_repair_after_bounded_solve(self):
+        # Lowering a used edge after a solve a bound stopped must still
+        # reroute its flow.
+        for alg in ALGORITHMS:
+            g = DenseFlowGraph(0, 1)
+            for tail, head in [(0, 2), (2, 1), (0, 3), (3, 1)]:
+                g.addedge(tail, head, 10.0)
+            g.calculatemaxflow(alg, max_iterations=1)
+            self.assertFalse(g.isoptimal())
+            g.setedgecapacity(1, 0.0)
+            flows = list(g.getflows())
+            self.assertEqual(flows[0], flows[1])
+            self.assertEqual(flows[2], flows[3])
+            self.assertEqual(g.calculatemaxflow(alg, warmstart=True), 10.0)
+            self.assertEqual(list(g.getflows()), [0.0, 0.0, 10.0, 10.0])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,26 @@
+# Reduced solves.  See test_terminals.py for how to run these.
+
+import unittest
+from maxflow import DenseFlowGraph
+
+
+class ReduceTest(unittest.TestCase):
+    def test_int32_parallel_edges(self):
+        # Merging these would take a capacity past 2**31 - 1.
+        for reduce in (False, True):
+            g = DenseFlowGraph(0, 1, capacity_type='int32')
+            g.addedge(0, 1, 2 * 10**9)
+            g.addedge(0, 1, 2 * 10**9)
+            self.assertEqual(g.calculatemaxflow('dinic', reduce=reduce), 4 * 10**9)
+            self.assertEqual(list(g.getflows()), [2 * 10**9] * 2)
+
+    def test_int32_terminal_sets(self):
+        g = DenseFlowGraph(0, 1, capacity_type='int32')
+        for v in (2, 3, 4):
+            g.addedge(v, 1, 10**9)
+        self.assertEqual(g.calculatemaxflow('push_relabel', sources=[2, 3, 4], sinks=[1],
+                                            reduce=True), 3 * 10**9)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,43 @@
+# Solves between sets of sources and sinks.  Run with the built package
+# on the path:
+#
+#     PYTHONPATH=build/lib.linux-x86_64-2.7 python -m unittest discover tests
+
+import unittest
+from maxflow import DenseFlowGraph
+
+ALGORITHMS = ['edmonds_karp', 'bidirectional_edmonds_karp', 'capacity_scaling',
+              'push_relabel', 'dinic', 'parallel_push_relabel']
+
+
+class TerminalSetTest(unittest.TestCase):
+    def graph(self, sources, capacity):
+        g = DenseFlowGraph(0, 1, capacity_type='int32')
+        for v in sources:
+            g.addedge(v, 1, capacity)
+        return g
+
+    def test_int32_several_sources(self):
+        # The sink takes in more than an int32 arc holds.
+        for alg in ALGORITHMS:
+            g = self.graph([2, 3, 4], 10**9)
+            self.assertEqual(g.calculatemaxflow(alg, sources=[2, 3, 4], sinks=[1]), 3 * 10**9)
+            self.assertEqual(list(g.getflows()), [10**9] * 3)
+
+    def test_int32_single_source(self):
+        for alg in ALGORITHMS:
+            g = self.graph([2], 10**9)
+            self.assertEqual(g.calculatemaxflow(alg, sources=[2], sinks=[1]), 10**9)
+
+    def test_int32_raised_capacity(self):
+        # Raising an edge at a terminal past its arcs rebuilds them.
+        for alg in ALGORITHMS:
+            g = self.graph([2, 3], 10**9)
+            g.calculatemaxflow(alg, sources=[2, 3], sinks=[1])
+            g.setedgecapacity(0, 2 * 10**9)
+            self.assertEqual(g.calculatemaxflow(alg, sources=[2, 3], sinks=[1], warmstart=True),
+                             3 * 10**9)
+
+
+if __name__ == '__main__':
+    unittest.main()